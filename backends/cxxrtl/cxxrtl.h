@@ -34,9 +34,11 @@
 #include <tuple>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <algorithm>
 #include <memory>
 #include <sstream>
+#include <cstring>
 
 #include <backends/cxxrtl/cxxrtl_capi.h>
 
@@ -766,6 +768,107 @@ struct memory {
 	}
 };
 
+// A memory with the same interface as `memory<Width>` for use by generated code, but which stores its contents
+// in pages that are only allocated when one of their elements is initialized or written. Elements of other pages
+// are zero, so that memories with huge address spaces only use storage proportional to the amount of pages actually
+// used. Since the contents are not contiguous, sparse memories cannot be inspected through the debug interface.
+template<size_t Width>
+struct sparse_memory {
+	static constexpr size_t page_depth = 1024;
+
+	struct page {
+		value<Width> data[page_depth];
+	};
+
+	size_t size;
+	std::unordered_map<size_t, std::unique_ptr<page>> pages;
+
+	size_t depth() const {
+		return size;
+	}
+
+	sparse_memory() = delete;
+	explicit sparse_memory(size_t depth) : size(depth) {}
+
+	sparse_memory(const sparse_memory<Width> &) = delete;
+	sparse_memory<Width> &operator=(const sparse_memory<Width> &) = delete;
+
+	template<size_t Size>
+	struct init {
+		size_t offset;
+		value<Width> data[Size];
+	};
+
+	// The initializers may overlap; like in `memory<Width>`, they are applied in order, so later ones take precedence.
+	template<size_t... InitSize>
+	explicit sparse_memory(size_t depth, const init<InitSize> &...init) : size(depth) {
+		auto _ = {apply_init(init.offset, std::begin(init.data), std::end(init.data))...};
+		(void)_;
+	}
+
+	bool apply_init(size_t offset, const value<Width> *begin, const value<Width> *end) {
+		assert(offset + (end - begin) <= size);
+		for (size_t index = offset; begin != end; index++)
+			(*this)[index] = *begin++;
+		return true;
+	}
+
+	page &page_at(size_t page_index) {
+		std::unique_ptr<page> &result = pages[page_index];
+		if (!result)
+			result.reset(new page);
+		return *result;
+	}
+
+	// An operator for direct memory reads. May be used at any time during the simulation. Does not allocate.
+	const value<Width> &operator [](size_t index) const {
+		static const value<Width> zero;
+		assert(index < size);
+		auto it = pages.find(index / page_depth);
+		if (it == pages.end())
+			return zero;
+		return it->second->data[index % page_depth];
+	}
+
+	// An operator for direct memory writes. May only be used before the simulation is started. If used after
+	// the simulation is started, the design may malfunction. Allocates the page of the element.
+	value<Width> &operator [](size_t index) {
+		assert(index < size);
+		return page_at(index / page_depth).data[index % page_depth];
+	}
+
+	// See `memory<Width>` for the rationale behind the write queue.
+	struct write {
+		size_t index;
+		value<Width> val;
+		value<Width> mask;
+		int priority;
+	};
+	std::vector<write> write_queue;
+
+	void update(size_t index, const value<Width> &val, const value<Width> &mask, int priority = 0) {
+		assert(index < size);
+		write_queue.insert(
+			std::upper_bound(write_queue.begin(), write_queue.end(), priority,
+				[](const int a, const write& b) { return a < b.priority; }),
+			write { index, val, mask, priority });
+	}
+
+	bool commit() {
+		bool changed = false;
+		for (const write &entry : write_queue) {
+			const value<Width> &curr = static_cast<const sparse_memory<Width> &>(*this)[entry.index];
+			value<Width> elem = curr.update(entry.val, entry.mask);
+			if (curr != elem) {
+				page_at(entry.index / page_depth).data[entry.index % page_depth] = elem;
+				changed = true;
+			}
+		}
+		write_queue.clear();
+		return changed;
+	}
+};
+
 struct metadata {
 	const enum {
 		MISSING = 0,
@@ -948,6 +1051,146 @@ struct debug_items {
 	}
 };
 
+// The complete state of a design (every wire, every memory, and all internal state such as the previous values of
+// unbuffered clocks used for edge detection) can be saved into a flat binary snapshot and later restored, which
+// makes it possible to e.g. fork many simulations from a common checkpoint.
+//
+// A snapshot is only a copy of the chunks of every state element in the order they are visited by the generated
+// code, in host byte order. Because of this, it can only be restored into a design compiled from the same netlist,
+// with the same options, for a platform with the same byte order.
+struct serializer {
+	// If `data` is null, only the size of the snapshot is computed.
+	uint8_t *data;
+	size_t size = 0;
+
+	explicit serializer(uint8_t *data = nullptr) : data(data) {}
+
+	void raw(const void *src, size_t length) {
+		if (data != nullptr)
+			memcpy(data + size, src, length);
+		size += length;
+	}
+
+	void chunks(const chunk_t *src, size_t count) {
+		raw(src, count * sizeof(chunk_t));
+	}
+
+	template<size_t Bits>
+	void operator()(const value<Bits> &val) {
+		chunks(val.data, value<Bits>::chunks);
+	}
+
+	template<size_t Bits>
+	void operator()(const wire<Bits> &val) {
+		chunks(val.curr.data, value<Bits>::chunks);
+		chunks(val.next.data, value<Bits>::chunks);
+	}
+
+	template<size_t Width>
+	void operator()(const memory<Width> &mem) {
+		// Snapshots may only be taken between delta cycles, when there are no pending writes.
+		assert(mem.write_queue.empty());
+		for (auto &elem : mem.data)
+			chunks(elem.data, value<Width>::chunks);
+	}
+
+	template<size_t Width>
+	void operator()(const sparse_memory<Width> &mem) {
+		assert(mem.write_queue.empty());
+		std::vector<uint64_t> page_indices;
+		for (auto &it : mem.pages)
+			page_indices.push_back(it.first);
+		std::sort(page_indices.begin(), page_indices.end());
+		uint64_t count = page_indices.size();
+		raw(&count, sizeof(count));
+		for (uint64_t page_index : page_indices) {
+			raw(&page_index, sizeof(page_index));
+			for (auto &elem : mem.pages.at(page_index)->data)
+				chunks(elem.data, value<Width>::chunks);
+		}
+	}
+};
+
+struct deserializer {
+	const uint8_t *data;
+	size_t size;
+	size_t offset = 0;
+	// If set, the snapshot is only checked for consistency with the design, and the design is not modified.
+	bool check_only;
+	bool failed = false;
+
+	deserializer(const uint8_t *data, size_t size, bool check_only = false) :
+		data(data), size(size), check_only(check_only) {}
+
+	bool raw(void *dst, size_t length) {
+		if (failed || length > size - offset) {
+			failed = true;
+			return false;
+		}
+		memcpy(dst, data + offset, length);
+		offset += length;
+		return true;
+	}
+
+	void chunks(chunk_t *dst, size_t count) {
+		if (failed || count * sizeof(chunk_t) > size - offset) {
+			failed = true;
+			return;
+		}
+		if (!check_only)
+			memcpy(dst, data + offset, count * sizeof(chunk_t));
+		offset += count * sizeof(chunk_t);
+	}
+
+	template<size_t Bits>
+	void operator()(value<Bits> &val) {
+		chunks(val.data, value<Bits>::chunks);
+	}
+
+	template<size_t Bits>
+	void operator()(wire<Bits> &val) {
+		chunks(val.curr.data, value<Bits>::chunks);
+		chunks(val.next.data, value<Bits>::chunks);
+	}
+
+	template<size_t Width>
+	void operator()(memory<Width> &mem) {
+		if (!check_only)
+			mem.write_queue.clear();
+		for (auto &elem : mem.data)
+			chunks(elem.data, value<Width>::chunks);
+	}
+
+	template<size_t Width>
+	void operator()(sparse_memory<Width> &mem) {
+		typedef typename sparse_memory<Width>::page page;
+		uint64_t count;
+		if (!raw(&count, sizeof(count)))
+			return;
+		if (!check_only) {
+			mem.write_queue.clear();
+			mem.pages.clear();
+		}
+		for (uint64_t n = 0; n < count; n++) {
+			uint64_t page_index;
+			if (!raw(&page_index, sizeof(page_index)))
+				return;
+			if (page_index >= (mem.size + sparse_memory<Width>::page_depth - 1) / sparse_memory<Width>::page_depth) {
+				failed = true;
+				return;
+			}
+			if (check_only) {
+				chunks(nullptr, sparse_memory<Width>::page_depth * value<Width>::chunks);
+				continue;
+			}
+			page *target = new page;
+			mem.pages[page_index].reset(target);
+			for (auto &elem : target->data)
+				chunks(elem.data, value<Width>::chunks);
+		}
+	}
+};
+
 struct module {
 	module() {}
 	virtual ~module() {}
@@ -971,6 +1214,64 @@ struct module {
 	virtual void debug_info(debug_items &items, std::string path = "") {
 		(void)items, (void)path;
 	}
+
+	// Visits every state element of the module and its submodules. Black boxes with internal state that is not
+	// exposed through ports must override both of these methods to make that state a part of the snapshot.
+	virtual void serialize(serializer &writer) const {
+		(void)writer;
+	}
+
+	virtual void deserialize(deserializer &reader) {
+		(void)reader;
+	}
+
+	static constexpr uint32_t snapshot_magic = 0x52585843; // "CXXR"
+	static constexpr uint32_t snapshot_version = 1;
+
+	size_t snapshot_size() const {
+		serializer writer;
+		serialize(writer);
+		return 2 * sizeof(uint32_t) + sizeof(uint64_t) + writer.size;
+	}
+
+	std::vector<uint8_t> snapshot() const {
+		std::vector<uint8_t> data(snapshot_size());
+		uint32_t magic = snapshot_magic, version = snapshot_version;
+		uint64_t payload_size = data.size() - 2 * sizeof(uint32_t) - sizeof(uint64_t);
+		memcpy(&data[0], &magic, sizeof(uint32_t));
+		memcpy(&data[sizeof(uint32_t)], &version, sizeof(uint32_t));
+		memcpy(&data[2 * sizeof(uint32_t)], &payload_size, sizeof(uint64_t));
+		serializer writer(&data[2 * sizeof(uint32_t) + sizeof(uint64_t)]);
+		serialize(writer);
+		assert(writer.size == payload_size);
+		return data;
+	}
+
+	// Returns false, leaving the state unchanged, if the snapshot was not taken from a compatible design.
+	bool restore(const uint8_t *data, size_t size) {
+		const size_t header_size = 2 * sizeof(uint32_t) + sizeof(uint64_t);
+		if (size < header_size)
+			return false;
+		uint32_t magic, version;
+		uint64_t payload_size;
+		memcpy(&magic, &data[0], sizeof(uint32_t));
+		memcpy(&version, &data[sizeof(uint32_t)], sizeof(uint32_t));
+		memcpy(&payload_size, &data[2 * sizeof(uint32_t)], sizeof(uint64_t));
+		if (magic != snapshot_magic || version != snapshot_version || payload_size != size - header_size)
+			return false;
+		deserializer checker(data + header_size, size - header_size, /*check_only=*/true);
+		deserialize(checker);
+		if (checker.failed || checker.offset != checker.size)
+			return false;
+		deserializer reader(data + header_size, size - header_size);
+		deserialize(reader);
+		assert(!reader.failed && reader.offset == reader.size);
+		return true;
+	}
+
+	bool restore(const std::vector<uint8_t> &data) {
+		return restore(data.data(), data.size());
+	}
 };
 
 } // namespace cxxrtl
@@ -1444,8 +1745,10 @@ struct memory_index {
 
 	template<size_t BitsAddr>
 	memory_index(const value<BitsAddr> &addr, size_t offset, size_t depth) {
-		static_assert(value<BitsAddr>::chunks <= 1, "memory address is too wide");
-		size_t offset_index = addr.data[0];
+		static_assert(value<BitsAddr>::chunks <= sizeof(size_t) / sizeof(chunk_t), "memory address is too wide");
+		size_t offset_index = 0;
+		for (size_t n = 0; n < value<BitsAddr>::chunks; n++)
+			offset_index |= size_t(addr.data[n]) << (n * value<BitsAddr>::chunk::bits);
 
 		valid = (offset_index >= offset && offset_index < offset + depth);
 		index = offset_index - offset;
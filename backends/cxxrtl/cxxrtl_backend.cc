@@ -517,7 +517,9 @@ std::string get_hdl_name(T *object)
 
 struct CxxrtlWorker {
 	bool split_intf = false;
+	bool split_modules = false;
 	std::string intf_filename;
+	std::string impl_basename;
 	std::string design_ns = "cxxrtl_design";
 	std::ostream *impl_f = nullptr;
 	std::ostream *intf_f = nullptr;
@@ -534,6 +536,9 @@ struct CxxrtlWorker {
 
 	bool debug_info = false;
 
+	// Memories with at least this many words are stored sparsely; 0 disables sparse storage.
+	int sparse_depth = 0;
+
 	std::ostringstream f;
 	std::string indent;
 	int temporary = 0;
@@ -1507,8 +1512,14 @@ struct CxxrtlWorker {
 		}
 	}
 
+	bool is_sparse_memory(const RTLIL::Memory *memory)
+	{
+		return sparse_depth > 0 && memory->size >= sparse_depth;
+	}
+
 	void dump_memory(RTLIL::Module *module, const RTLIL::Memory *memory)
 	{
+		std::string memory_type = stringf("%s<%d>", is_sparse_memory(memory) ? "sparse_memory" : "memory", memory->width);
 		vector<const RTLIL::Cell*> init_cells;
 		for (auto cell : module->cells())
 			if (cell->type == ID($meminit) && cell->getParam(ID::MEMID).decode_string() == memory->name.str())
@@ -1521,7 +1532,7 @@ struct CxxrtlWorker {
 		});
 
 		dump_attrs(memory);
-		f << indent << "memory<" << memory->width << "> " << mangle(memory)
+		f << indent << memory_type << " " << mangle(memory)
 		            << " { " << memory->size << "u";
 		if (init_cells.empty()) {
 			f << " };\n";
@@ -1533,7 +1544,7 @@ struct CxxrtlWorker {
 					RTLIL::Const data = cell->getPort(ID::DATA).as_const();
 					size_t width = cell->getParam(ID::WIDTH).as_int();
 					size_t words = cell->getParam(ID::WORDS).as_int();
-					f << indent << "memory<" << memory->width << ">::init<" << words << "> { "
+					f << indent << memory_type << "::init<" << words << "> { "
 					            << stringf("%#x", cell->getPort(ID::ADDR).as_int()) << ", {";
 					inc_indent();
 						for (size_t n = 0; n < words; n++) {
@@ -1628,6 +1639,34 @@ struct CxxrtlWorker {
 		dec_indent();
 	}
 
+	void dump_serialize_method(RTLIL::Module *module, bool is_deserialize)
+	{
+		const char *visitor = is_deserialize ? "reader" : "writer";
+		inc_indent();
+			f << indent << "(void)" << visitor << ";\n";
+			for (auto wire : module->wires()) {
+				if (elided_wires.count(wire) || localized_wires[wire])
+					continue;
+				if (module->get_bool_attribute(ID(cxxrtl_blackbox)) && wire->port_id == 0)
+					continue;
+				f << indent << visitor << "(" << mangle(wire) << ");\n";
+				if (edge_wires[wire] && unbuffered_wires[wire])
+					f << indent << visitor << "(prev_" << mangle(wire) << ");\n";
+			}
+			if (!module->get_bool_attribute(ID(cxxrtl_blackbox))) {
+				for (auto memory : module->memories)
+					f << indent << visitor << "(" << mangle(memory.second) << ");\n";
+				for (auto cell : module->cells()) {
+					if (is_internal_cell(cell->type))
+						continue;
+					const char *access = is_cxxrtl_blackbox_cell(cell) ? "->" : ".";
+					f << indent << mangle(cell) << access << (is_deserialize ? "deserialize" : "serialize");
+					f << "(" << visitor << ");\n";
+				}
+			}
+		dec_indent();
+	}
+
 	void dump_debug_info_method(RTLIL::Module *module)
 	{
 		size_t count_public_wires = 0;
@@ -1672,6 +1711,9 @@ struct CxxrtlWorker {
 				for (auto &memory_it : module->memories) {
 					if (memory_it.first[0] != '\\')
 						continue;
+					// Sparse memories have no contiguous storage that could be exposed.
+					if (is_sparse_memory(memory_it.second))
+						continue;
 					f << indent << "items.add(path + " << escape_cxx_string(get_hdl_name(memory_it.second));
 					f << ", debug_item(" << mangle(memory_it.second) << ", ";
 					f << memory_it.second->start_offset << "));\n";
@@ -1748,6 +1790,14 @@ struct CxxrtlWorker {
 					f << indent << "}\n";
 					f << "\n";
 				}
+				f << indent << "void serialize(serializer &writer) const override {\n";
+				dump_serialize_method(module, /*is_deserialize=*/false);
+				f << indent << "}\n";
+				f << "\n";
+				f << indent << "void deserialize(deserializer &reader) override {\n";
+				dump_serialize_method(module, /*is_deserialize=*/true);
+				f << indent << "}\n";
+				f << "\n";
 				f << indent << "static std::unique_ptr<" << mangle(module);
 				f << template_params(module, /*is_decl=*/false) << "> ";
 				f << "create(std::string name, metadata_map parameters, metadata_map attributes);\n";
@@ -1812,6 +1862,8 @@ struct CxxrtlWorker {
 				f << indent << "bool commit() override;\n";
 				if (debug_info)
 					f << indent << "void debug_info(debug_items &items, std::string path = \"\") override;\n";
+				f << indent << "void serialize(serializer &writer) const override;\n";
+				f << indent << "void deserialize(deserializer &reader) override;\n";
 			dec_indent();
 			f << indent << "}; // struct " << mangle(module) << "\n";
 			f << "\n";
@@ -1822,6 +1874,9 @@ struct CxxrtlWorker {
 	{
 		if (module->get_bool_attribute(ID(cxxrtl_blackbox)))
 			return;
+		// Temporaries are local to the methods of a module, so restarting the numbering keeps the code generated
+		// for one module independent of the modules emitted before it.
+		temporary = 0;
 		f << indent << "bool " << mangle(module) << "::eval() {\n";
 		dump_eval_method(module);
 		f << indent << "}\n";
@@ -1836,6 +1891,45 @@ struct CxxrtlWorker {
 			f << indent << "}\n";
 			f << "\n";
 		}
+		f << indent << "void " << mangle(module) << "::serialize(serializer &writer) const {\n";
+		dump_serialize_method(module, /*is_deserialize=*/false);
+		f << indent << "}\n";
+		f << "\n";
+		f << indent << "void " << mangle(module) << "::deserialize(deserializer &reader) {\n";
+		dump_serialize_method(module, /*is_deserialize=*/true);
+		f << indent << "}\n";
+		f << "\n";
+	}
+
+	std::string module_impl_filename(RTLIL::Module *module)
+	{
+		std::string name = mangle(module);
+		// Names of derived modules can be arbitrarily long, but file names cannot.
+		if (name.size() > 128)
+			name = name.substr(0, 96) + stringf("_%08x", hash_ops<std::string>::hash(name));
+		return impl_basename + "_" + name + ".cc";
+	}
+
+	// Files that already have the right contents are left untouched, so that their modification time does not
+	// change and build systems do not recompile them.
+	void write_if_changed(const std::string &filename, const std::string &contents)
+	{
+		std::ifstream old_f(filename, std::ifstream::binary);
+		if (!old_f.fail()) {
+			std::stringstream old_contents;
+			old_contents << old_f.rdbuf();
+			if (old_contents.str() == contents) {
+				log("Keeping unchanged file `%s'.\n", filename.c_str());
+				return;
+			}
+		}
+		old_f.close();
+
+		std::ofstream new_f(filename, std::ofstream::trunc | std::ofstream::binary);
+		if (new_f.fail())
+			log_error("Can't open file `%s' for writing: %s\n", filename.c_str(), strerror(errno));
+		new_f << contents;
+		log("Writing file `%s'.\n", filename.c_str());
 	}
 
 	void dump_design(RTLIL::Design *design)
@@ -1930,10 +2024,28 @@ struct CxxrtlWorker {
 		for (auto module : modules) {
 			if (!split_intf)
 				dump_module_intf(module);
-			dump_module_impl(module);
+			if (!split_modules)
+				dump_module_impl(module);
 		}
 		f << "} // namespace " << design_ns << "\n";
 		f << "\n";
+		if (split_modules) {
+			std::string impl_prefix = f.str(); f.str("");
+			for (auto module : modules) {
+				if (module->get_bool_attribute(ID(cxxrtl_blackbox)))
+					continue;
+				f << "#include \"" << intf_filename << "\"\n";
+				f << "\n";
+				f << "using namespace cxxrtl_yosys;\n";
+				f << "\n";
+				f << "namespace " << design_ns << " {\n";
+				f << "\n";
+				dump_module_impl(module);
+				f << "} // namespace " << design_ns << "\n";
+				write_if_changed(module_impl_filename(module), f.str()); f.str("");
+			}
+			f << impl_prefix;
+		}
 		if (top_module != nullptr && debug_info) {
 			f << "extern \"C\"\n";
 			f << "cxxrtl_toplevel " << design_ns << "_create() {\n";
@@ -2390,6 +2502,9 @@ struct CxxrtlBackend : public Backend {
 		log("      bool eval() override;\n");
 		log("      bool commit() override;\n");
 		log("\n");
+		log("      void serialize(serializer &writer) const override;\n");
+		log("      void deserialize(deserializer &reader) override;\n");
+		log("\n");
 		log("      static std::unique_ptr<bb_p_debug>\n");
 		log("      create(std::string name, metadata_map parameters, metadata_map attributes);\n");
 		log("    };\n");
@@ -2416,6 +2531,12 @@ struct CxxrtlBackend : public Backend {
 		log("\n");
 		log("    }\n");
 		log("\n");
+		log("The `serialize' and `deserialize' methods save and restore the values of the\n");
+		log("ports as a part of a design snapshot (see `module::snapshot()' and\n");
+		log("`module::restore()' in the runtime library, or `cxxrtl_snapshot' and\n");
+		log("`cxxrtl_restore' in the C API). A black box implementation that has internal\n");
+		log("state must override them and call the base class methods as well.\n");
+		log("\n");
 		log("For complex applications of black boxes, it is possible to parameterize their\n");
 		log("port widths. For example, the following Verilog code defines a CXXRTL black box\n");
 		log("interface for a configurable width debug sink:\n");
@@ -2495,10 +2616,26 @@ struct CxxrtlBackend : public Backend {
 		log("        of the interface is derived from filename of the implementation.\n");
 		log("        otherwise, interface and implementation are generated together.\n");
 		log("\n");
+		log("    -split\n");
+		log("        like -header, and additionally place the implementation of every module\n");
+		log("        into a separate file named `<basename>_<module>.cc', where <basename> is\n");
+		log("        the filename of the implementation without the extension. the file with\n");
+		log("        the given filename only contains the C API entry point. this makes it\n");
+		log("        possible to compile the modules in parallel and incrementally; files\n");
+		log("        (including the interface) whose contents did not change are not\n");
+		log("        rewritten. this option is most useful together with -noflatten.\n");
+		log("\n");
 		log("    -namespace <ns-name>\n");
 		log("        place the generated code into namespace <ns-name>. if not specified,\n");
 		log("        \"cxxrtl_design\" is used.\n");
 		log("\n");
+		log("    -sparse <depth>\n");
+		log("        store memories with at least <depth> words sparsely, allocating storage\n");
+		log("        in pages only when they are written to. this makes it possible to\n");
+		log("        simulate memories with very large address spaces, such as a system\n");
+		log("        memory map, at the cost of slower accesses. sparse memories are not\n");
+		log("        visible through the debug interface.\n");
+		log("\n");
 		log("    -noflatten\n");
 		log("        don't flatten the design. fully flattened designs can evaluate within\n");
 		log("        one delta cycle if they have no combinatorial feedback.\n");
@@ -2603,6 +2740,15 @@ struct CxxrtlBackend : public Backend {
 				worker.split_intf = true;
 				continue;
 			}
+			if (args[argidx] == "-split") {
+				worker.split_intf = true;
+				worker.split_modules = true;
+				continue;
+			}
+			if (args[argidx] == "-sparse" && argidx+1 < args.size()) {
+				worker.sparse_depth = std::stoi(args[++argidx]);
+				continue;
+			}
 			if (args[argidx] == "-namespace" && argidx+1 < args.size()) {
 				worker.design_ns = args[++argidx];
 				continue;
@@ -2650,22 +2796,31 @@ struct CxxrtlBackend : public Backend {
 		}
 
 		std::ofstream intf_f;
+		std::ostringstream split_intf_f;
 		if (worker.split_intf) {
 			if (filename == "<stdout>")
-				log_cmd_error("Option -header must be used with a filename.\n");
-
-			worker.intf_filename = filename.substr(0, filename.rfind('.')) + ".h";
-			intf_f.open(worker.intf_filename, std::ofstream::trunc);
-			if (intf_f.fail())
-				log_cmd_error("Can't open file `%s' for writing: %s\n",
-				              worker.intf_filename.c_str(), strerror(errno));
+				log_cmd_error("Option %s must be used with a filename.\n", worker.split_modules ? "-split" : "-header");
 
-			worker.intf_f = &intf_f;
+			worker.impl_basename = filename.substr(0, filename.rfind('.'));
+			worker.intf_filename = worker.impl_basename + ".h";
+			if (worker.split_modules) {
+				// The interface is only rewritten if it changes, since every module implementation depends on it.
+				worker.intf_f = &split_intf_f;
+			} else {
+				intf_f.open(worker.intf_filename, std::ofstream::trunc);
+				if (intf_f.fail())
+					log_cmd_error("Can't open file `%s' for writing: %s\n",
+					              worker.intf_filename.c_str(), strerror(errno));
+				worker.intf_f = &intf_f;
+			}
 		}
 		worker.impl_f = f;
 
 		worker.prepare_design(design);
 		worker.dump_design(design);
+
+		if (worker.split_modules)
+			worker.write_if_changed(worker.intf_filename, split_intf_f.str());
 	}
 } CxxrtlBackend;
 
@@ -24,6 +24,7 @@
 struct _cxxrtl_handle {
 	std::unique_ptr<cxxrtl::module> module;
 	cxxrtl::debug_items objects;
+	std::vector<uint8_t> snapshot;
 };
 
 // Private function for use by other units of the C API.
@@ -55,6 +56,16 @@ size_t cxxrtl_step(cxxrtl_handle handle) {
 	return handle->module->step();
 }
 
+void cxxrtl_snapshot(cxxrtl_handle handle, const uint8_t **data, size_t *size) {
+	handle->snapshot = handle->module->snapshot();
+	*data = handle->snapshot.data();
+	*size = handle->snapshot.size();
+}
+
+int cxxrtl_restore(cxxrtl_handle handle, const uint8_t *data, size_t size) {
+	return handle->module->restore(data, size);
+}
+
 struct cxxrtl_object *cxxrtl_get_parts(cxxrtl_handle handle, const char *name, size_t *parts) {
 	auto it = handle->objects.table.find(name);
 	if (it == handle->objects.table.end())
@@ -72,6 +72,23 @@ int cxxrtl_commit(cxxrtl_handle handle);
 // Returns the number of delta cycles.
 size_t cxxrtl_step(cxxrtl_handle handle);
 
+// Save the complete state of the design.
+//
+// The pointer to a snapshot of every wire, memory, and internal state element of the design is
+// assigned to `*data`, and the length of the snapshot is assigned to `*size`. The pointer to
+// the data is valid until the next call to `cxxrtl_snapshot` or until the design is destroyed.
+//
+// A snapshot can only be taken when the design is not in the middle of a delta cycle, i.e. not
+// between `cxxrtl_eval` and `cxxrtl_commit`. It can be restored into any handle created from
+// the same generated code, and is not portable between platforms with different byte order.
+void cxxrtl_snapshot(cxxrtl_handle handle, const uint8_t **data, size_t *size);
+
+// Restore the complete state of the design from a snapshot.
+//
+// Returns 1 if the state was restored, 0 if the snapshot was not taken from a compatible design,
+// in which case the state is left unchanged.
+int cxxrtl_restore(cxxrtl_handle handle, const uint8_t *data, size_t size);
+
 // Type of a simulated object.
 enum cxxrtl_type {
 	// Values correspond to singly buffered netlist nodes, i.e. nodes driven exclusively by
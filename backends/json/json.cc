@@ -23,223 +23,212 @@
 #include "kernel/celltypes.h"
 #include "kernel/cellaigs.h"
 #include "kernel/log.h"
+#include "kernel/threading.h"
 #include <string>
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
 
-struct JsonWriter
-{
-	std::ostream &f;
-	bool use_selection;
-	bool aig_mode;
-	bool compat_int_mode;
+struct JsonWriter;
 
-	Design *design;
-	Module *module;
+// Serializes one module into a string buffer. Module writers for different modules may run concurrently on
+// worker threads; see JsonWriter::write_design() for the data that is prepared for them on the main thread.
+struct JsonModuleWriter
+{
+	JsonWriter &writer;
+	std::string &out;
 
 	SigMap sigmap;
 	int sigidcounter;
-	dict<SigBit, string> sigids;
-	pool<Aig> aig_models;
+	dict<SigBit, int> sigids;
 
-	JsonWriter(std::ostream &f, bool use_selection, bool aig_mode, bool compat_int_mode) :
-			f(f), use_selection(use_selection), aig_mode(aig_mode),
-			compat_int_mode(compat_int_mode) { }
+	JsonModuleWriter(JsonWriter &writer, std::string &out) : writer(writer), out(out) { }
 
-	string get_string(string str)
+	void newline(int indent);
+
+	void write_int(long long value)
 	{
-		string newstr = "\"";
+		char buf[24], *p = buf + sizeof(buf);
+		unsigned long long v = value < 0 ? -(unsigned long long)value : value;
+		do {
+			*--p = '0' + v % 10;
+			v /= 10;
+		} while (v != 0);
+		if (value < 0)
+			*--p = '-';
+		out.append(p, buf + sizeof(buf) - p);
+	}
+
+	void write_string(const string &str)
+	{
+		out += '"';
 		for (char c : str) {
 			if (c == '\\')
-				newstr += c;
-			newstr += c;
+				out += c;
+			out += c;
 		}
-		return newstr + "\"";
+		out += '"';
 	}
 
-	string get_name(IdString name)
+	void write_name(const IdString &name)
 	{
-		return get_string(RTLIL::unescape_id(name));
+		write_string(RTLIL::unescape_id(name.str()));
 	}
 
-	string get_bits(SigSpec sig)
+	void write_bits(const SigSpec &sig)
 	{
 		bool first = true;
-		string str = "[";
+		out += '[';
 		for (auto bit : sigmap(sig)) {
-			str += first ? " " : ", ";
+			out += first ? " " : ", ";
 			first = false;
-			if (sigids.count(bit) == 0) {
-				string &s = sigids[bit];
-				if (bit.wire == nullptr) {
-					if (bit == State::S0) s = "\"0\"";
-					else if (bit == State::S1) s = "\"1\"";
-					else if (bit == State::Sz) s = "\"z\"";
-					else s = "\"x\"";
-				} else
-					s = stringf("%d", sigidcounter++);
+			if (bit.wire == nullptr) {
+				if (bit == State::S0) out += "\"0\"";
+				else if (bit == State::S1) out += "\"1\"";
+				else if (bit == State::Sz) out += "\"z\"";
+				else out += "\"x\"";
+				continue;
 			}
-			str += sigids[bit];
+			auto it = sigids.find(bit);
+			if (it == sigids.end())
+				it = sigids.emplace(bit, sigidcounter++).first;
+			write_int(it->second);
 		}
-		return str + " ]";
+		out += " ]";
 	}
 
-	void write_parameter_value(const Const &value)
-	{
-		if ((value.flags & RTLIL::ConstFlags::CONST_FLAG_STRING) != 0) {
-			string str = value.decode_string();
-			int state = 0;
-			for (char c : str) {
-				if (state == 0) {
-					if (c == '0' || c == '1' || c == 'x' || c == 'z')
-						state = 0;
-					else if (c == ' ')
-						state = 1;
-					else
-						state = 2;
-				} else if (state == 1 && c != ' ')
-					state = 2;
-			}
-			if (state < 2)
-				str += " ";
-			f << get_string(str);
-		} else if (compat_int_mode && GetSize(value) <= 32 && value.is_fully_def()) {
-			if ((value.flags & RTLIL::ConstFlags::CONST_FLAG_SIGNED) != 0)
-				f << stringf("%d", value.as_int());
-			else
-				f << stringf("%u", value.as_int());
-		} else {
-			f << get_string(value.as_string());
-		}
-	}
+	void write_parameter_value(const Const &value);
 
 	void write_parameters(const dict<IdString, Const> &parameters, bool for_module=false)
 	{
 		bool first = true;
 		for (auto &param : parameters) {
-			f << stringf("%s\n", first ? "" : ",");
-			f << stringf("        %s%s: ", for_module ? "" : "    ", get_name(param.first).c_str());
+			if (!first)
+				out += ',';
+			newline(for_module ? 8 : 12);
+			write_name(param.first);
+			out += ": ";
 			write_parameter_value(param.second);
 			first = false;
 		}
 	}
 
-	void write_module(Module *module_)
+	void write_wire_details(Wire *w)
 	{
-		module = module_;
-		log_assert(module->design == design);
-		sigmap.set(module);
-		sigids.clear();
+		if (w->start_offset) {
+			newline(10);
+			out += "\"offset\": ";
+			write_int(w->start_offset);
+			out += ',';
+		}
+		if (w->upto) {
+			newline(10);
+			out += "\"upto\": 1,";
+		}
+		if (w->is_signed) {
+			newline(10);
+			out += "\"signed\": 1,";
+		}
+	}
 
-		// reserve 0 and 1 to avoid confusion with "0" and "1"
-		sigidcounter = 2;
+	void write_module(Module *module, const vector<Wire*> &ports, const vector<Cell*> &cells, const vector<Wire*> &wires);
+};
 
-		f << stringf("    %s: {\n", get_name(module->name).c_str());
+struct JsonWriter
+{
+	std::ostream &f;
+	bool use_selection;
+	bool aig_mode;
+	bool compat_int_mode;
+	bool compact_mode;
 
-		f << stringf("      \"attributes\": {");
-		write_parameters(module->attributes, /*for_module=*/true);
-		f << stringf("\n      },\n");
+	Design *design;
+	pool<Aig> aig_models;
 
-		if (module->parameter_default_values.size()) {
-			f << stringf("      \"parameter_default_values\": {");
-			write_parameters(module->parameter_default_values, /*for_module=*/true);
-			f << stringf("\n      },\n");
+	// Port directions of all cell types with a known interface that occur in the written modules. This is
+	// looked up by the module writers instead of Cell::known(), Cell::input() and Cell::output(), which copy
+	// IdStrings and may thus not be called on worker threads.
+	struct CellPorts {
+		pool<IdString> inputs, outputs;
+	};
+	dict<IdString, CellPorts> known_cells;
+
+	// The objects of a module that are written, after applying the selection.
+	struct ModuleJob {
+		Module *module;
+		vector<Wire*> ports, wires;
+		vector<Cell*> cells;
+	};
+
+	JsonWriter(std::ostream &f, bool use_selection, bool aig_mode, bool compat_int_mode, bool compact_mode) :
+			f(f), use_selection(use_selection), aig_mode(aig_mode),
+			compat_int_mode(compat_int_mode), compact_mode(compact_mode) { }
+
+	string get_string(string str)
+	{
+		string newstr = "\"";
+		for (char c : str) {
+			if (c == '\\')
+				newstr += c;
+			newstr += c;
 		}
+		return newstr + "\"";
+	}
 
-		f << stringf("      \"ports\": {");
-		bool first = true;
+	string newline(int indent)
+	{
+		return compact_mode ? "" : "\n" + string(indent, ' ');
+	}
+
+	void add_cell_type(IdString type)
+	{
+		if (known_cells.count(type))
+			return;
+		if (yosys_celltypes.cell_known(type)) {
+			auto &ct = yosys_celltypes.cell_types.at(type);
+			known_cells[type] = CellPorts{ct.inputs, ct.outputs};
+			return;
+		}
+		Module *m = design->module(type);
+		if (m == nullptr)
+			return;
+		CellPorts &ports = known_cells[type];
+		for (auto w : m->wires()) {
+			if (w->port_input)
+				ports.inputs.insert(w->name);
+			if (w->port_output)
+				ports.outputs.insert(w->name);
+		}
+	}
+
+	ModuleJob prepare_module(Module *module)
+	{
+		log_assert(module->design == design);
+
+		ModuleJob job;
+		job.module = module;
 		for (auto n : module->ports) {
 			Wire *w = module->wire(n);
-			if (use_selection && !module->selected(w))
-				continue;
-			f << stringf("%s\n", first ? "" : ",");
-			f << stringf("        %s: {\n", get_name(n).c_str());
-			f << stringf("          \"direction\": \"%s\",\n", w->port_input ? w->port_output ? "inout" : "input" : "output");
-			if (w->start_offset)
-				f << stringf("          \"offset\": %d,\n", w->start_offset);
-			if (w->upto)
-				f << stringf("          \"upto\": 1,\n");
-			if (w->is_signed)
-				f << stringf("          \"signed\": %d,\n", w->is_signed);
-			f << stringf("          \"bits\": %s\n", get_bits(w).c_str());
-			f << stringf("        }");
-			first = false;
+			if (!use_selection || module->selected(w))
+				job.ports.push_back(w);
 		}
-		f << stringf("\n      },\n");
-
-		f << stringf("      \"cells\": {");
-		first = true;
 		for (auto c : module->cells()) {
-			if (use_selection && !module->selected(c))
-				continue;
-			f << stringf("%s\n", first ? "" : ",");
-			f << stringf("        %s: {\n", get_name(c->name).c_str());
-			f << stringf("          \"hide_name\": %s,\n", c->name[0] == '$' ? "1" : "0");
-			f << stringf("          \"type\": %s,\n", get_name(c->type).c_str());
-			if (aig_mode) {
-				Aig aig(c);
-				if (!aig.name.empty()) {
-					f << stringf("          \"model\": \"%s\",\n", aig.name.c_str());
-					aig_models.insert(aig);
-				}
-			}
-			f << stringf("          \"parameters\": {");
-			write_parameters(c->parameters);
-			f << stringf("\n          },\n");
-			f << stringf("          \"attributes\": {");
-			write_parameters(c->attributes);
-			f << stringf("\n          },\n");
-			if (c->known()) {
-				f << stringf("          \"port_directions\": {");
-				bool first2 = true;
-				for (auto &conn : c->connections()) {
-					string direction = "output";
-					if (c->input(conn.first))
-						direction = c->output(conn.first) ? "inout" : "input";
-					f << stringf("%s\n", first2 ? "" : ",");
-					f << stringf("            %s: \"%s\"", get_name(conn.first).c_str(), direction.c_str());
-					first2 = false;
-				}
-				f << stringf("\n          },\n");
-			}
-			f << stringf("          \"connections\": {");
-			bool first2 = true;
-			for (auto &conn : c->connections()) {
-				f << stringf("%s\n", first2 ? "" : ",");
-				f << stringf("            %s: %s", get_name(conn.first).c_str(), get_bits(conn.second).c_str());
-				first2 = false;
+			if (!use_selection || module->selected(c)) {
+				job.cells.push_back(c);
+				add_cell_type(c->type);
 			}
-			f << stringf("\n          }\n");
-			f << stringf("        }");
-			first = false;
 		}
-		f << stringf("\n      },\n");
-
-		f << stringf("      \"netnames\": {");
-		first = true;
 		for (auto w : module->wires()) {
-			if (use_selection && !module->selected(w))
-				continue;
-			f << stringf("%s\n", first ? "" : ",");
-			f << stringf("        %s: {\n", get_name(w->name).c_str());
-			f << stringf("          \"hide_name\": %s,\n", w->name[0] == '$' ? "1" : "0");
-			f << stringf("          \"bits\": %s,\n", get_bits(w).c_str());
-			if (w->start_offset)
-				f << stringf("          \"offset\": %d,\n", w->start_offset);
-			if (w->upto)
-				f << stringf("          \"upto\": 1,\n");
-			if (w->is_signed)
-				f << stringf("          \"signed\": %d,\n", w->is_signed);
-			f << stringf("          \"attributes\": {");
-			write_parameters(w->attributes);
-			f << stringf("\n          }\n");
-			f << stringf("        }");
-			first = false;
+			if (!use_selection || module->selected(w))
+				job.wires.push_back(w);
 		}
-		f << stringf("\n      }\n");
+		return job;
+	}
 
-		f << stringf("    }");
+	void write_module(const ModuleJob &job, std::string &out)
+	{
+		JsonModuleWriter module_writer(*this, out);
+		module_writer.write_module(job.module, job.ports, job.cells, job.wires);
 	}
 
 	void write_design(Design *design_)
@@ -247,30 +236,70 @@ struct JsonWriter
 		design = design_;
 		design->sort();
 
-		f << stringf("{\n");
-		f << stringf("  \"creator\": %s,\n", get_string(yosys_version_str).c_str());
-		f << stringf("  \"modules\": {\n");
+		f << "{" << newline(2);
+		f << "\"creator\": " << get_string(yosys_version_str) << "," << newline(2);
+		f << "\"modules\": {";
+
 		vector<Module*> modules = use_selection ? design->selected_modules() : design->modules();
-		bool first_module = true;
-		for (auto mod : modules) {
-			if (!first_module)
-				f << stringf(",\n");
-			write_module(mod);
-			first_module = false;
+		vector<ModuleJob> jobs;
+		for (auto mod : modules)
+			jobs.push_back(prepare_module(mod));
+
+		// Modules are serialized into separate buffers, which are written out in order as soon as they are
+		// complete. AIG models are collected while the cells are written and must thus stay on the main thread.
+		int pool_size = aig_mode ? 0 : ThreadPool::pool_size(0, GetSize(jobs) - 1);
+		if (pool_size == 0) {
+			std::string buffer;
+			for (int i = 0; i < GetSize(jobs); i++) {
+				buffer.clear();
+				write_module(jobs[i], buffer);
+				f << (i ? "," : "") << buffer;
+			}
+		} else {
+			ConcurrentQueue<int> pending;
+			ConcurrentQueue<std::pair<int, std::string>> done;
+			for (int i = 0; i < GetSize(jobs); i++)
+				pending.push_back(std::move(i));
+			pending.close();
+
+			ThreadPool pool(pool_size, [&](int) {
+				int i;
+				while (pending.pop_front(i)) {
+					std::string buffer;
+					write_module(jobs[i], buffer);
+					done.push_back(std::make_pair(i, std::move(buffer)));
+				}
+			});
+
+			dict<int, std::string> finished;
+			std::pair<int, std::string> result;
+			for (int next = 0; next < GetSize(jobs); ) {
+				done.pop_front(result);
+				finished[result.first] = std::move(result.second);
+				for (auto it = finished.find(next); it != finished.end(); it = finished.find(next)) {
+					f << (next ? "," : "") << it->second;
+					finished.erase(it);
+					next++;
+				}
+			}
 		}
-		f << stringf("\n  }");
+
+		// An empty list of modules is written with a blank line between the braces.
+		if (jobs.empty())
+			f << newline(0);
+		f << newline(2) << "}";
 		if (!aig_models.empty()) {
-			f << stringf(",\n  \"models\": {\n");
+			f << "," << newline(2) << "\"models\": {";
 			bool first_model = true;
 			for (auto &aig : aig_models) {
 				if (!first_model)
-					f << stringf(",\n");
-				f << stringf("    \"%s\": [\n", aig.name.c_str());
+					f << ",";
+				f << newline(4) << stringf("\"%s\": [", aig.name.c_str());
 				int node_idx = 0;
 				for (auto &node : aig.nodes) {
 					if (node_idx != 0)
-						f << stringf(",\n");
-					f << stringf("      /* %3d */ [ ", node_idx);
+						f << ",";
+					f << newline(6) << stringf("/* %3d */ [ ", node_idx);
 					if (node.portbit >= 0)
 						f << stringf("\"%sport\", \"%s\", %d", node.inverter ? "n" : "",
 								log_id(node.portname), node.portbit);
@@ -283,15 +312,211 @@ struct JsonWriter
 					f << stringf(" ]");
 					node_idx++;
 				}
-				f << stringf("\n    ]");
+				f << newline(4) << "]";
 				first_model = false;
 			}
-			f << stringf("\n  }");
+			f << newline(2) << "}";
 		}
-		f << stringf("\n}\n");
+		f << newline(0) << "}\n";
 	}
 };
 
+void JsonModuleWriter::newline(int indent)
+{
+	if (!writer.compact_mode) {
+		out += '\n';
+		out.append(indent, ' ');
+	}
+}
+
+void JsonModuleWriter::write_parameter_value(const Const &value)
+{
+	if ((value.flags & RTLIL::ConstFlags::CONST_FLAG_STRING) != 0) {
+		string str = value.decode_string();
+		int state = 0;
+		for (char c : str) {
+			if (state == 0) {
+				if (c == '0' || c == '1' || c == 'x' || c == 'z')
+					state = 0;
+				else if (c == ' ')
+					state = 1;
+				else
+					state = 2;
+			} else if (state == 1 && c != ' ')
+				state = 2;
+		}
+		if (state < 2)
+			str += " ";
+		write_string(str);
+	} else if (writer.compat_int_mode && GetSize(value) <= 32 && value.is_fully_def()) {
+		if ((value.flags & RTLIL::ConstFlags::CONST_FLAG_SIGNED) != 0)
+			write_int(value.as_int());
+		else
+			write_int((unsigned int)value.as_int());
+	} else {
+		write_string(value.as_string());
+	}
+}
+
+void JsonModuleWriter::write_module(Module *module, const vector<Wire*> &ports, const vector<Cell*> &cells, const vector<Wire*> &wires)
+{
+	sigmap.set(module);
+	sigids.clear();
+
+	// reserve 0 and 1 to avoid confusion with "0" and "1"
+	sigidcounter = 2;
+
+	newline(4);
+	write_name(module->name);
+	out += ": {";
+
+	newline(6);
+	out += "\"attributes\": {";
+	write_parameters(module->attributes, /*for_module=*/true);
+	newline(6);
+	out += "},";
+
+	if (module->parameter_default_values.size()) {
+		newline(6);
+		out += "\"parameter_default_values\": {";
+		write_parameters(module->parameter_default_values, /*for_module=*/true);
+		newline(6);
+		out += "},";
+	}
+
+	newline(6);
+	out += "\"ports\": {";
+	bool first = true;
+	for (auto w : ports) {
+		if (!first)
+			out += ',';
+		newline(8);
+		write_name(w->name);
+		out += ": {";
+		newline(10);
+		out += "\"direction\": \"";
+		out += w->port_input ? w->port_output ? "inout" : "input" : "output";
+		out += "\",";
+		write_wire_details(w);
+		newline(10);
+		out += "\"bits\": ";
+		write_bits(w);
+		newline(8);
+		out += '}';
+		first = false;
+	}
+	newline(6);
+	out += "},";
+
+	newline(6);
+	out += "\"cells\": {";
+	first = true;
+	for (auto c : cells) {
+		if (!first)
+			out += ',';
+		newline(8);
+		write_name(c->name);
+		out += ": {";
+		newline(10);
+		out += "\"hide_name\": ";
+		out += c->name[0] == '$' ? "1," : "0,";
+		newline(10);
+		out += "\"type\": ";
+		write_name(c->type);
+		out += ',';
+		if (writer.aig_mode) {
+			Aig aig(c);
+			if (!aig.name.empty()) {
+				newline(10);
+				out += "\"model\": \"" + aig.name + "\",";
+				writer.aig_models.insert(aig);
+			}
+		}
+		newline(10);
+		out += "\"parameters\": {";
+		write_parameters(c->parameters);
+		newline(10);
+		out += "},";
+		newline(10);
+		out += "\"attributes\": {";
+		write_parameters(c->attributes);
+		newline(10);
+		out += "},";
+		auto known = writer.known_cells.find(c->type);
+		if (known != writer.known_cells.end()) {
+			newline(10);
+			out += "\"port_directions\": {";
+			bool first2 = true;
+			for (auto &conn : c->connections()) {
+				const char *direction = "output";
+				if (known->second.inputs.count(conn.first))
+					direction = known->second.outputs.count(conn.first) ? "inout" : "input";
+				if (!first2)
+					out += ',';
+				newline(12);
+				write_name(conn.first);
+				out += ": \"";
+				out += direction;
+				out += '"';
+				first2 = false;
+			}
+			newline(10);
+			out += "},";
+		}
+		newline(10);
+		out += "\"connections\": {";
+		bool first2 = true;
+		for (auto &conn : c->connections()) {
+			if (!first2)
+				out += ',';
+			newline(12);
+			write_name(conn.first);
+			out += ": ";
+			write_bits(conn.second);
+			first2 = false;
+		}
+		newline(10);
+		out += '}';
+		newline(8);
+		out += '}';
+		first = false;
+	}
+	newline(6);
+	out += "},";
+
+	newline(6);
+	out += "\"netnames\": {";
+	first = true;
+	for (auto w : wires) {
+		if (!first)
+			out += ',';
+		newline(8);
+		write_name(w->name);
+		out += ": {";
+		newline(10);
+		out += "\"hide_name\": ";
+		out += w->name[0] == '$' ? "1," : "0,";
+		newline(10);
+		out += "\"bits\": ";
+		write_bits(w);
+		out += ',';
+		write_wire_details(w);
+		newline(10);
+		out += "\"attributes\": {";
+		write_parameters(w->attributes);
+		newline(10);
+		out += '}';
+		newline(8);
+		out += '}';
+		first = false;
+	}
+	newline(6);
+	out += '}';
+
+	newline(4);
+	out += '}';
+}
+
 struct JsonBackend : public Backend {
 	JsonBackend() : Backend("json", "write design to a JSON file") { }
 	void help() override
@@ -309,6 +534,9 @@ struct JsonBackend : public Backend {
 		log("        emit 32-bit or smaller fully-defined parameter values directly\n");
 		log("        as JSON numbers (for compatibility with old parsers)\n");
 		log("\n");
+		log("    -compact\n");
+		log("        do not indent the output and do not break it into lines\n");
+		log("\n");
 		log("\n");
 		log("The general syntax of the JSON output created by this command is as follows:\n");
 		log("\n");
@@ -534,6 +762,7 @@ struct JsonBackend : public Backend {
 	{
 		bool aig_mode = false;
 		bool compat_int_mode = false;
+		bool compact_mode = false;
 
 		size_t argidx;
 		for (argidx = 1; argidx < args.size(); argidx++)
@@ -546,13 +775,17 @@ struct JsonBackend : public Backend {
 				compat_int_mode = true;
 				continue;
 			}
+			if (args[argidx] == "-compact") {
+				compact_mode = true;
+				continue;
+			}
 			break;
 		}
 		extra_args(f, filename, args, argidx);
 
 		log_header(design, "Executing JSON backend.\n");
 
-		JsonWriter json_writer(*f, false, aig_mode, compat_int_mode);
+		JsonWriter json_writer(*f, false, aig_mode, compat_int_mode, compact_mode);
 		json_writer.write_design(design);
 	}
 } JsonBackend;
@@ -577,6 +810,9 @@ struct JsonPass : public Pass {
 		log("        emit 32-bit or smaller fully-defined parameter values directly\n");
 		log("        as JSON numbers (for compatibility with old parsers)\n");
 		log("\n");
+		log("    -compact\n");
+		log("        do not indent the output and do not break it into lines\n");
+		log("\n");
 		log("See 'help write_json' for a description of the JSON format used.\n");
 		log("\n");
 	}
@@ -585,6 +821,7 @@ struct JsonPass : public Pass {
 		std::string filename;
 		bool aig_mode = false;
 		bool compat_int_mode = false;
+		bool compact_mode = false;
 
 		size_t argidx;
 		for (argidx = 1; argidx < args.size(); argidx++)
@@ -601,6 +838,10 @@ struct JsonPass : public Pass {
 				compat_int_mode = true;
 				continue;
 			}
+			if (args[argidx] == "-compact") {
+				compact_mode = true;
+				continue;
+			}
 			break;
 		}
 		extra_args(args, argidx, design);
@@ -621,7 +862,7 @@ struct JsonPass : public Pass {
 			f = &buf;
 		}
 
-		JsonWriter json_writer(*f, true, aig_mode, compat_int_mode);
+		JsonWriter json_writer(*f, true, aig_mode, compat_int_mode, compact_mode);
 		json_writer.write_design(design);
 
 		if (!filename.empty()) {
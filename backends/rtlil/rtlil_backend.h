@@ -44,6 +44,18 @@ namespace RTLIL_BACKEND {
 	void dump_conn(std::ostream &f, std::string indent, const RTLIL::SigSpec &left, const RTLIL::SigSpec &right);
 	void dump_module(std::ostream &f, std::string indent, RTLIL::Module *module, RTLIL::Design *design, bool only_selected, bool flag_m = true, bool flag_n = false);
 	void dump_design(std::ostream &f, RTLIL::Design *design, bool only_selected, bool flag_m = true, bool flag_n = false);
+
+	// Binary RTLIL, written by `write_rtlil -binary' and recognized by read_rtlil. The file starts with
+	// `binary_magic', followed by the format version, autoidx and the modules. All integers are LEB128
+	// varints (zigzag encoded if signed). Strings are interned: a reference to the n-th distinct string
+	// is encoded as n+1, and 0 is followed by the length and bytes of a new string. Bit vectors start
+	// with (width << 1 | packed), followed by 1 bit (if all bits are 0/1) or 4 bits (otherwise) per
+	// state. SigSpecs are lists of chunks referencing wires by their index in the module.
+	const char binary_magic[] = "\x89RTLILB\n";
+	const int binary_magic_size = 8;
+	const int binary_version = 1;
+
+	void dump_design_binary(std::ostream &f, RTLIL::Design *design, bool only_selected);
 }
 
 YOSYS_NAMESPACE_END
@@ -0,0 +1,260 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *  ---
+ *
+ *  A compact binary representation of RTLIL, for fast checkpointing of large
+ *  designs. See rtlil_backend.h for a description of the format.
+ *
+ */
+
+#include "rtlil_backend.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+namespace {
+
+struct BinaryWriter
+{
+	std::ostream &f;
+	std::string buffer;
+	dict<std::string, int> strings;
+	dict<const RTLIL::Wire*, int> wire_index;
+
+	BinaryWriter(std::ostream &f) : f(f) {}
+
+	~BinaryWriter()
+	{
+		flush();
+	}
+
+	void flush()
+	{
+		f.write(buffer.data(), buffer.size());
+		buffer.clear();
+	}
+
+	void byte(uint8_t value)
+	{
+		buffer += char(value);
+		if (buffer.size() >= 65536)
+			flush();
+	}
+
+	void varint(uint64_t value)
+	{
+		while (value >= 0x80) {
+			byte(uint8_t(value | 0x80));
+			value >>= 7;
+		}
+		byte(uint8_t(value));
+	}
+
+	void svarint(int64_t value)
+	{
+		varint(value < 0 ? ((uint64_t(-(value + 1)) << 1) | 1) : (uint64_t(value) << 1));
+	}
+
+	void str(const std::string &str)
+	{
+		auto it = strings.find(str);
+		if (it != strings.end()) {
+			varint(it->second + 1);
+			return;
+		}
+		int index = GetSize(strings);
+		strings[str] = index;
+		varint(0);
+		varint(str.size());
+		buffer += str;
+		if (buffer.size() >= 65536)
+			flush();
+	}
+
+	void id(RTLIL::IdString id)
+	{
+		str(id.str());
+	}
+
+	void bits(const std::vector<RTLIL::State> &bits, int offset, int width)
+	{
+		bool defined = true;
+		for (int i = 0; i < width && defined; i++)
+			defined = bits[offset + i] == State::S0 || bits[offset + i] == State::S1;
+		varint(uint64_t(width) << 1 | (defined ? 0 : 1));
+		int per_byte = defined ? 8 : 2;
+		for (int i = 0; i < width; i += per_byte) {
+			uint8_t packed = 0;
+			for (int j = 0; j < per_byte && i + j < width; j++)
+				packed |= uint8_t(bits[offset + i + j]) << (j * (defined ? 1 : 4));
+			byte(packed);
+		}
+	}
+
+	void constant(const RTLIL::Const &value)
+	{
+		varint(value.flags);
+		bits(value.bits, 0, GetSize(value.bits));
+	}
+
+	void attributes(const RTLIL::AttrObject *obj)
+	{
+		varint(obj->attributes.size());
+		for (auto &it : obj->attributes) {
+			id(it.first);
+			constant(it.second);
+		}
+	}
+
+	void sigspec(const RTLIL::SigSpec &sig)
+	{
+		varint(sig.chunks().size());
+		for (auto &chunk : sig.chunks()) {
+			if (chunk.wire == nullptr) {
+				varint(0);
+				bits(chunk.data, 0, chunk.width);
+			} else {
+				varint(wire_index.at(chunk.wire) + 1);
+				varint(chunk.offset);
+				varint(chunk.width);
+			}
+		}
+	}
+
+	void sigsig(const RTLIL::SigSig &conn)
+	{
+		sigspec(conn.first);
+		sigspec(conn.second);
+	}
+
+	void case_rule(const RTLIL::CaseRule *cs)
+	{
+		attributes(cs);
+		varint(cs->compare.size());
+		for (auto &sig : cs->compare)
+			sigspec(sig);
+		varint(cs->actions.size());
+		for (auto &action : cs->actions)
+			sigsig(action);
+		varint(cs->switches.size());
+		for (auto sw : cs->switches) {
+			attributes(sw);
+			sigspec(sw->signal);
+			varint(sw->cases.size());
+			for (auto child : sw->cases)
+				case_rule(child);
+		}
+	}
+
+	void module(RTLIL::Module *module)
+	{
+		id(module->name);
+		attributes(module);
+
+		varint(module->avail_parameters.size());
+		for (auto param : module->avail_parameters) {
+			id(param);
+			auto it = module->parameter_default_values.find(param);
+			byte(it != module->parameter_default_values.end());
+			if (it != module->parameter_default_values.end())
+				constant(it->second);
+		}
+
+		wire_index.clear();
+		varint(GetSize(module->wires()));
+		for (auto wire : module->wires()) {
+			int index = GetSize(wire_index);
+			wire_index[wire] = index;
+			id(wire->name);
+			attributes(wire);
+			varint(wire->width);
+			svarint(wire->start_offset);
+			varint(wire->port_id);
+			byte(wire->port_input << 0 | wire->port_output << 1 | wire->upto << 2 | wire->is_signed << 3);
+		}
+
+		varint(module->memories.size());
+		for (auto &it : module->memories) {
+			id(it.second->name);
+			attributes(it.second);
+			varint(it.second->width);
+			varint(it.second->size);
+			svarint(it.second->start_offset);
+		}
+
+		varint(GetSize(module->cells()));
+		for (auto cell : module->cells()) {
+			id(cell->name);
+			id(cell->type);
+			attributes(cell);
+			varint(cell->parameters.size());
+			for (auto &it : cell->parameters) {
+				id(it.first);
+				constant(it.second);
+			}
+			varint(cell->connections().size());
+			for (auto &it : cell->connections()) {
+				id(it.first);
+				sigspec(it.second);
+			}
+		}
+
+		varint(module->processes.size());
+		for (auto &it : module->processes) {
+			const RTLIL::Process *proc = it.second;
+			id(proc->name);
+			attributes(proc);
+			case_rule(&proc->root_case);
+			varint(proc->syncs.size());
+			for (auto sync : proc->syncs) {
+				byte(sync->type);
+				sigspec(sync->signal);
+				varint(sync->actions.size());
+				for (auto &action : sync->actions)
+					sigsig(action);
+			}
+		}
+
+		varint(module->connections().size());
+		for (auto &conn : module->connections())
+			sigsig(conn);
+	}
+};
+
+}
+
+void RTLIL_BACKEND::dump_design_binary(std::ostream &f, RTLIL::Design *design, bool only_selected)
+{
+	BinaryWriter writer(f);
+	writer.buffer.append(binary_magic, binary_magic_size);
+	writer.varint(binary_version);
+	writer.varint(autoidx);
+
+	std::vector<RTLIL::Module*> modules;
+	for (auto module : design->modules()) {
+		if (!only_selected || design->selected_whole_module(module->name))
+			modules.push_back(module);
+		else if (design->selected(module))
+			log_cmd_error("Can't write partially selected module %s in binary RTLIL format.\n", log_id(module));
+	}
+
+	writer.varint(modules.size());
+	for (auto module : modules)
+		writer.module(module);
+}
+
+YOSYS_NAMESPACE_END
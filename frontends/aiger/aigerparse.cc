@@ -257,7 +257,7 @@ end_of_header:
 	else
 		log_abort();
 
-	RTLIL::Wire* n0 = module->wire(stringf("$aiger%d$0", aiger_autoidx));
+	RTLIL::Wire* n0 = literal_wires.at(0);
 	if (n0)
 		module->connect(n0, State::S0);
 
@@ -325,34 +325,62 @@ static uint32_t parse_xaiger_literal(std::istream &f)
 	return from_big_endian(l);
 }
 
+// Sizes the literal tables and the wire and cell storage of the module from the header counts.
+void AigerReader::reserve_objects()
+{
+	literal_wires.assign(2 * (size_t(M) + 1), nullptr);
+	and_cells.assign(size_t(M) + 1, nullptr);
+	module->wires_.reserve(2 * size_t(M) + I + L + O + 1);
+	module->cells_.reserve(size_t(A) + L + M / 2);
+}
+
+std::string AigerReader::aiger_name(const char *prefix, unsigned variable, const char *suffix)
+{
+	std::string name = prefix;
+	name += "$aiger";
+	name += std::to_string(aiger_autoidx);
+	name += '$';
+	name += std::to_string(variable);
+	name += suffix;
+	return name;
+}
+
 RTLIL::Wire* AigerReader::createWireIfNotExists(RTLIL::Module *module, unsigned literal)
 {
 	const unsigned variable = literal >> 1;
 	const bool invert = literal & 1;
-	RTLIL::IdString wire_name(stringf("$aiger%d$%d%s", aiger_autoidx, variable, invert ? "b" : ""));
-	RTLIL::Wire *wire = module->wire(wire_name);
+	if (literal >= literal_wires.size())
+		log_error("Literal %u exceeds maximum variable index %u!\n", literal, M);
+	RTLIL::Wire *&wire = literal_wires[literal];
 	if (wire) return wire;
+	RTLIL::IdString wire_name = aiger_name("", variable, invert ? "b" : "");
 	log_debug2("Creating %s\n", wire_name.c_str());
 	wire = module->addWire(wire_name);
 	wire->port_input = wire->port_output = false;
 	if (!invert) return wire;
-	RTLIL::IdString wire_inv_name(stringf("$aiger%d$%d", aiger_autoidx, variable));
-	RTLIL::Wire *wire_inv = module->wire(wire_inv_name);
-	if (wire_inv) {
-		if (module->cell(wire_inv_name)) return wire;
-	}
-	else {
-		log_debug2("Creating %s\n", wire_inv_name.c_str());
-		wire_inv = module->addWire(wire_inv_name);
+	RTLIL::Wire *&wire_inv = literal_wires[literal ^ 1];
+	if (!wire_inv) {
+		log_debug2("Creating %s\n", aiger_name("", variable).c_str());
+		wire_inv = module->addWire(aiger_name("", variable));
 		wire_inv->port_input = wire_inv->port_output = false;
 	}
 
-	log_debug2("Creating %s = ~%s\n", wire_name.c_str(), wire_inv_name.c_str());
-	module->addNotGate(stringf("$not$aiger%d$%d", aiger_autoidx, variable), wire_inv, wire);
+	log_debug2("Creating %s = ~%s\n", wire_name.c_str(), wire_inv->name.c_str());
+	module->addNotGate(aiger_name("$not", variable), wire_inv, wire);
 
 	return wire;
 }
 
+void AigerReader::createAndGate(RTLIL::Module *module, unsigned l1, unsigned l2, unsigned l3)
+{
+	log_debug2("%d %d %d is an AND\n", l1, l2, l3);
+	log_assert(!(l1 & 1));
+	RTLIL::Wire *o_wire = createWireIfNotExists(module, l1);
+	RTLIL::Wire *i1_wire = createWireIfNotExists(module, l2);
+	RTLIL::Wire *i2_wire = createWireIfNotExists(module, l3);
+	and_cells[l1 >> 1] = module->addAndGate("$and" + o_wire->name.str(), i1_wire, i2_wire, o_wire);
+}
+
 void AigerReader::parse_xaiger()
 {
 	std::string header;
@@ -385,7 +413,7 @@ void AigerReader::parse_xaiger()
 	else
 		log_abort();
 
-	RTLIL::Wire* n0 = module->wire(stringf("$aiger%d$0", aiger_autoidx));
+	RTLIL::Wire* n0 = literal_wires.at(0);
 	if (n0)
 		module->connect(n0, State::S0);
 
@@ -409,7 +437,8 @@ void AigerReader::parse_xaiger()
 				uint32_t rootNodeID = parse_xaiger_literal(f);
 				uint32_t cutLeavesM = parse_xaiger_literal(f);
 				log_debug2("rootNodeID=%d cutLeavesM=%d\n", rootNodeID, cutLeavesM);
-				RTLIL::Wire *output_sig = module->wire(stringf("$aiger%d$%d", aiger_autoidx, rootNodeID));
+				log_assert(rootNodeID <= M);
+				RTLIL::Wire *output_sig = literal_wires[2 * size_t(rootNodeID)];
 				log_assert(output_sig);
 				uint32_t nodeID;
 				RTLIL::SigSpec input_sig;
@@ -420,7 +449,8 @@ void AigerReader::parse_xaiger()
 						log_debug("\tLUT '$lut$aiger%d$%d' input %d is constant!\n", aiger_autoidx, rootNodeID, cutLeavesM);
 						continue;
 					}
-					RTLIL::Wire *wire = module->wire(stringf("$aiger%d$%d", aiger_autoidx, nodeID));
+					log_assert(nodeID <= M);
+					RTLIL::Wire *wire = literal_wires[2 * size_t(nodeID)];
 					log_assert(wire);
 					input_sig.append(wire);
 				}
@@ -439,10 +469,11 @@ void AigerReader::parse_xaiger()
 					log_assert(o.wire == nullptr);
 					lut_mask[gray] = o.data;
 				}
-				RTLIL::Cell *output_cell = module->cell(stringf("$and$aiger%d$%d", aiger_autoidx, rootNodeID));
+				RTLIL::Cell *output_cell = and_cells[rootNodeID];
 				log_assert(output_cell);
 				module->remove(output_cell);
-				module->addLut(stringf("$lut$aiger%d$%d", aiger_autoidx, rootNodeID), input_sig, output_sig, std::move(lut_mask));
+				and_cells[rootNodeID] = nullptr;
+				module->addLut(aiger_name("$lut", rootNodeID), input_sig, output_sig, std::move(lut_mask));
 			}
 		}
 		else if (c == 'r') {
@@ -512,6 +543,8 @@ void AigerReader::parse_aiger_ascii()
 	std::string line;
 	std::stringstream ss;
 
+	reserve_objects();
+
 	unsigned l1, l2, l3;
 
 	// Parse inputs
@@ -618,12 +651,7 @@ void AigerReader::parse_aiger_ascii()
 		if (!(f >> l1 >> l2 >> l3))
 			log_error("Line %u cannot be interpreted as an AND!\n", line_count);
 
-		log_debug2("%d %d %d is an AND\n", l1, l2, l3);
-		log_assert(!(l1 & 1));
-		RTLIL::Wire *o_wire = createWireIfNotExists(module, l1);
-		RTLIL::Wire *i1_wire = createWireIfNotExists(module, l2);
-		RTLIL::Wire *i2_wire = createWireIfNotExists(module, l3);
-		module->addAndGate("$and" + o_wire->name.str(), i1_wire, i2_wire, o_wire);
+		createAndGate(module, l1, l2, l3);
 	}
 	std::getline(f, line); // Ignore up to start of next line
 }
@@ -642,6 +670,8 @@ void AigerReader::parse_aiger_binary()
 	unsigned l1, l2, l3;
 	std::string line;
 
+	reserve_objects();
+
 	// Parse inputs
 	int digits = ceil(log10(I));
 	for (unsigned i = 1; i <= I; ++i) {
@@ -744,12 +774,7 @@ void AigerReader::parse_aiger_binary()
 		l2 = parse_next_delta_literal(f, l1);
 		l3 = parse_next_delta_literal(f, l2);
 
-		log_debug2("%d %d %d is an AND\n", l1, l2, l3);
-		log_assert(!(l1 & 1));
-		RTLIL::Wire *o_wire = createWireIfNotExists(module, l1);
-		RTLIL::Wire *i1_wire = createWireIfNotExists(module, l2);
-		RTLIL::Wire *i2_wire = createWireIfNotExists(module, l3);
-		module->addAndGate("$and" + o_wire->name.str(), i1_wire, i2_wire, o_wire);
+		createAndGate(module, l1, l2, l3);
 	}
 }
 
@@ -47,6 +47,11 @@ struct AigerReader
     std::vector<RTLIL::Cell*> boxes;
     std::vector<int> mergeability, initial_state;
 
+    // Wires for all literals and AND gates for all variables, indexed by literal and variable, so that the
+    // parser never needs to look them up by name.
+    std::vector<RTLIL::Wire*> literal_wires;
+    std::vector<RTLIL::Cell*> and_cells;
+
     AigerReader(RTLIL::Design *design, std::istream &f, RTLIL::IdString module_name, RTLIL::IdString clk_name, std::string map_filename, bool wideports);
     void parse_aiger();
     void parse_xaiger();
@@ -54,7 +59,10 @@ struct AigerReader
     void parse_aiger_binary();
     void post_process();
 
+    void reserve_objects();
+    std::string aiger_name(const char *prefix, unsigned variable, const char *suffix = "");
     RTLIL::Wire* createWireIfNotExists(RTLIL::Module *module, unsigned literal);
+    void createAndGate(RTLIL::Module *module, unsigned l1, unsigned l2, unsigned l3);
 };
 
 YOSYS_NAMESPACE_END
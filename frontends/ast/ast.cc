@@ -1425,6 +1425,129 @@ void AstModule::reprocess_module(RTLIL::Design *design, const dict<RTLIL::IdStri
 	mod->set_bool_attribute(ID::interfaces_replaced_in_module);
 }
 
+// Derived modules are cached, keyed by a hash of everything the generated RTLIL depends on: the AST of the module,
+// the frontend options stored with it, the parameter values and the interface bindings. When the same sources are
+// read again (e.g. after `design -stash' or `read_verilog -overwrite'), deriving the parametric modules of the
+// hierarchy then only needs to copy the cached modules. The warnings printed while deriving a module are stored with
+// it and printed again on a cache hit. The cache is dropped by clear_derive_cache() on `design -reset', `design -load'
+// and `design -reset-vlog'.
+struct DeriveCacheEntry {
+	std::unique_ptr<RTLIL::Module> module;
+	int autoidx;
+	std::vector<std::pair<std::string, std::string>> warnings;
+};
+
+static dict<std::string, DeriveCacheEntry> derive_cache;
+
+void AST::clear_derive_cache()
+{
+	derive_cache.clear();
+}
+
+// Records the warnings printed while a module is derived, for storing them in the cache.
+struct DeriveWarningsCapture {
+	std::vector<std::pair<std::string, std::string>> warnings;
+	std::vector<std::pair<std::string, std::string>> *outer;
+
+	DeriveWarningsCapture() : outer(log_warnings_capture) {
+		log_warnings_capture = &warnings;
+	}
+
+	~DeriveWarningsCapture() {
+		log_warnings_capture = outer;
+		if (outer != nullptr)
+			outer->insert(outer->end(), warnings.begin(), warnings.end());
+	}
+};
+
+bool AST::serialize_ast(const AstNode *node, std::string &data)
+{
+	if (node->type == AST_TCALL && (node->str == "$readmemh" || node->str == "$readmemb"))
+		return false;
+
+	data += stringf("(%d %s:%d.%d-%d.%d '%s' ", node->type, node->filename.c_str(), node->location.first_line,
+			node->location.first_column, node->location.last_line, node->location.last_column, node->str.c_str());
+	for (auto bit : node->bits)
+		data += bit == State::S0 ? '0' : bit == State::S1 ? '1' : bit == State::Sx ? 'x' : bit == State::Sz ? 'z' : '-';
+	data += stringf(" %d%d%d%d%d%d%d%d%d%d%d%d%d%d %d %d %d %u %a", node->is_input, node->is_output, node->is_reg, node->is_logic,
+			node->is_signed, node->is_string, node->is_wand, node->is_wor, node->range_valid, node->range_swapped,
+			node->was_checked, node->is_unsized, node->is_custom_type, node->is_enum, node->port_id, node->range_left,
+			node->range_right, node->integer, node->realvalue);
+	for (int dim : node->multirange_dimensions)
+		data += stringf(" %d", dim);
+	for (auto &attr : node->attributes) {
+		data += stringf(" %s=", attr.first.c_str());
+		if (!serialize_ast(attr.second, data))
+			return false;
+	}
+	for (auto child : node->children)
+		if (!serialize_ast(child, data))
+			return false;
+	data += ")";
+	return true;
+}
+
+// Returns an empty string if the module must not be cached.
+static std::string derive_cache_key(const AstModule *module, const dict<RTLIL::IdString, RTLIL::Const> &parameters,
+		const dict<RTLIL::IdString, RTLIL::Module*> &interfaces, const dict<RTLIL::IdString, RTLIL::IdString> &modports)
+{
+	std::string data = stringf("%s %d%d%d%d%d%d%d%d%d%d%d ", module->name.c_str(), module->nolatches, module->nomeminit,
+			module->nomem2reg, module->mem2reg, module->noblackbox, module->lib, module->nowb, module->noopt, module->icells,
+			module->pwires, module->autowire);
+	if (!serialize_ast(module->ast, data))
+		return std::string();
+
+	for (auto &param : parameters)
+		data += stringf(" %s=%s/%d", param.first.c_str(), param.second.as_string().c_str(), param.second.flags);
+
+	for (auto &intf : interfaces) {
+		// The interface module is exploded into ports, so its contents are part of the key as well.
+		auto intf_module = dynamic_cast<const AstModule*>(intf.second);
+		if (intf_module == nullptr || intf_module->ast == nullptr)
+			return std::string();
+		data += stringf(" %s:%s.%s=", intf.first.c_str(), intf.second->name.c_str(),
+				modports.count(intf.first) ? modports.at(intf.first).c_str() : "");
+		if (!serialize_ast(intf_module->ast, data))
+			return std::string();
+		for (auto wire : intf.second->wires())
+			data += stringf(" %s/%d", wire->name.c_str(), wire->width);
+	}
+
+	return sha1(data);
+}
+
+// Adds a copy of the cached module to the design if there is one.
+static bool derive_from_cache(RTLIL::Design *design, const std::string &key, const std::string &modname, bool quiet = false)
+{
+	if (key.empty())
+		return false;
+	auto it = derive_cache.find(key);
+	if (it == derive_cache.end())
+		return false;
+
+	RTLIL::Module *mod = it->second.module->clone();
+	log_assert(mod->name == modname);
+	design->add(mod);
+	// Make sure that names generated from now on can't clash with the ones in the cached module.
+	autoidx = std::max(autoidx, it->second.autoidx);
+	if (!quiet)
+		log("Found cached derivation for module `%s'.\n", modname.c_str());
+	for (auto &warning : it->second.warnings)
+		log_replay_warning(warning.first, warning.second);
+	return true;
+}
+
+static void add_to_derive_cache(RTLIL::Design *design, const std::string &key, const std::string &modname,
+		const DeriveWarningsCapture &capture)
+{
+	if (key.empty())
+		return;
+	DeriveCacheEntry &entry = derive_cache[key];
+	entry.module.reset(design->module(modname)->clone());
+	entry.autoidx = autoidx;
+	entry.warnings = capture.warnings;
+}
+
 // create a new parametric module (when needed) and return the name of the generated module - WITH support for interfaces
 // This method is used to explode the interface when the interface is a port of the module (not instantiated inside)
 RTLIL::IdString AstModule::derive(RTLIL::Design *design, const dict<RTLIL::IdString, RTLIL::Const> &parameters, const dict<RTLIL::IdString, RTLIL::Module*> &interfaces, const dict<RTLIL::IdString, RTLIL::IdString> &modports, bool /*mayfail*/)
@@ -1447,8 +1570,14 @@ RTLIL::IdString AstModule::derive(RTLIL::Design *design, const dict<RTLIL::IdStr
 	if (has_interfaces)
 		new_modname += "$interfaces$" + interf_info;
 
+	std::string cache_key;
+	if (!design->has(new_modname))
+		cache_key = derive_cache_key(this, parameters, interfaces, modports);
 
-	if (!design->has(new_modname)) {
+	if (!design->has(new_modname) && derive_from_cache(design, cache_key, new_modname)) {
+		modname = new_modname;
+	} else if (!design->has(new_modname)) {
+		DeriveWarningsCapture capture;
 		if (!new_ast) {
 			auto mod = dynamic_cast<AstModule*>(design->module(modname));
 			new_ast = mod->ast->clone();
@@ -1504,6 +1633,8 @@ RTLIL::IdString AstModule::derive(RTLIL::Design *design, const dict<RTLIL::IdStr
 			mod->set_bool_attribute(ID::interfaces_replaced_in_module);
 		}
 
+		add_to_derive_cache(design, cache_key, modname, capture);
+
 	} else {
 		log("Found cached RTLIL representation for module `%s'.\n", modname.c_str());
 	}
@@ -1521,9 +1652,14 @@ RTLIL::IdString AstModule::derive(RTLIL::Design *design, const dict<RTLIL::IdStr
 	std::string modname = derive_common(design, parameters, &new_ast, quiet);
 
 	if (!design->has(modname)) {
-		new_ast->str = modname;
-		design->add(process_module(new_ast, false, NULL, quiet));
-		design->module(modname)->check();
+		std::string cache_key = derive_cache_key(this, parameters, {}, {});
+		if (!derive_from_cache(design, cache_key, modname, quiet)) {
+			DeriveWarningsCapture capture;
+			new_ast->str = modname;
+			design->add(process_module(new_ast, false, NULL, quiet));
+			design->module(modname)->check();
+			add_to_derive_cache(design, cache_key, modname, capture);
+		}
 	} else if (!quiet) {
 		log("Found cached RTLIL representation for module `%s'.\n", modname.c_str());
 	}
@@ -318,6 +318,13 @@ namespace AST
 	void process(RTLIL::Design *design, AstNode *ast, bool dump_ast1, bool dump_ast2, bool no_dump_ptr, bool dump_vlog1, bool dump_vlog2, bool dump_rtlil, bool nolatches, bool nomeminit,
 			bool nomem2reg, bool mem2reg, bool noblackbox, bool lib, bool nowb, bool noopt, bool icells, bool pwires, bool nooverwrite, bool overwrite, bool defer, bool autowire);
 
+	// append a serialization of an AST to `data' for use in cache keys. returns false if the AST depends on
+	// anything besides itself, such as memory initialization files, and must therefore not be cached.
+	bool serialize_ast(const AstNode *node, std::string &data);
+
+	// drop all parametric modules cached by AstModule::derive()
+	void clear_derive_cache();
+
 	// parametric modules are supported directly by the AST library
 	// therefore we need our own derivate of RTLIL::Module with overloaded virtual functions
 	struct AstModule : RTLIL::Module {
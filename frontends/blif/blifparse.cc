@@ -21,39 +21,72 @@
 
 YOSYS_NAMESPACE_BEGIN
 
-static bool read_next_line(char *&buffer, size_t &buffer_size, int &line_count, std::istream &f)
+// The whole input is read into memory with a few large reads, and lines are returned (and then tokenized)
+// in place. Only lines that are continued with a trailing backslash are copied into a separate buffer.
+struct BlifLineReader
 {
-	string strbuf;
-	int buffer_len = 0;
-	buffer[0] = 0;
+	std::vector<char> data;
+	size_t pos = 0;
+	std::string joined;
+	int line_count = 0;
 
-	while (1)
+	BlifLineReader(std::istream &f)
 	{
-		buffer_len += strlen(buffer + buffer_len);
-		while (buffer_len > 0 && (buffer[buffer_len-1] == ' ' || buffer[buffer_len-1] == '\t' ||
-				buffer[buffer_len-1] == '\r' || buffer[buffer_len-1] == '\n'))
-			buffer[--buffer_len] = 0;
-
-		if (buffer_size-buffer_len < 4096) {
-			buffer_size *= 2;
-			buffer = (char*)realloc(buffer, buffer_size);
+		size_t size = 0;
+		data.resize(1 << 20);
+		while (f.read(data.data() + size, data.size() - size) || f.gcount() > 0) {
+			size += f.gcount();
+			if (size == data.size())
+				data.resize(2 * size);
 		}
+		data.resize(size);
+		if (size > 0 && data.back() != '\n')
+			data.push_back('\n');
+	}
+
+	static bool is_space(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+	}
 
-		if (buffer_len == 0 || buffer[buffer_len-1] == '\\') {
-			if (buffer_len > 0 && buffer[buffer_len-1] == '\\')
-				buffer[--buffer_len] = 0;
+	// Returns the next non-empty line, with trailing whitespace removed and continued lines joined, or
+	// nullptr at the end of the input.
+	char *next_line()
+	{
+		joined.clear();
+		while (1)
+		{
 			line_count++;
-			if (!std::getline(f, strbuf))
-				return false;
-			while (buffer_size-buffer_len < strbuf.size()+1) {
-				buffer_size *= 2;
-				buffer = (char*)realloc(buffer, buffer_size);
+			if (pos == data.size())
+				return nullptr;
+
+			char *begin = data.data() + pos;
+			char *end = (char*)memchr(begin, '\n', data.size() - pos);
+			pos = end - data.data() + 1;
+
+			if (joined.empty()) {
+				while (end > begin && is_space(end[-1]))
+					end--;
+				if (end == begin)
+					continue;
+				if (end[-1] != '\\') {
+					*end = 0;
+					return begin;
+				}
+				joined.assign(begin, end - 1);
+			} else {
+				joined.append(begin, end);
+				while (!joined.empty() && is_space(joined.back()))
+					joined.pop_back();
+				if (joined.empty())
+					continue;
+				if (joined.back() != '\\')
+					return &joined[0];
+				joined.pop_back();
 			}
-			strcpy(buffer+buffer_len, strbuf.c_str());
-		} else
-			return true;
+		}
 	}
-}
+};
 
 static std::pair<RTLIL::IdString, int> wideports_split(std::string name)
 {
@@ -83,33 +116,41 @@ void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool
 	RTLIL::Module *module = nullptr;
 	RTLIL::Const *lutptr = NULL;
 	RTLIL::Cell *sopcell = NULL;
+	RTLIL::Const *sop_table = NULL;
+	int sop_depth = 0;
 	RTLIL::Cell *lastcell = nullptr;
 	RTLIL::State lut_default_state = RTLIL::State::Sx;
 	std::string err_reason;
 	int blif_maxnum = 0, sopmode = -1;
 
-	auto blif_wire = [&](const std::string &wire_name) -> Wire*
+	std::string wire_name_buf;
+
+	auto blif_wire = [&](const char *wire_name) -> Wire*
 	{
 		if (wire_name[0] == '$')
 		{
-			for (int i = 0; i+1 < GetSize(wire_name); i++)
+			for (int i = 0; wire_name[i] && wire_name[i+1]; i++)
 			{
 				if (wire_name[i] != '$')
 					continue;
 
 				int len = 0;
-				while (i+len+1 < GetSize(wire_name) && '0' <= wire_name[i+len+1] && wire_name[i+len+1] <= '9')
+				while ('0' <= wire_name[i+len+1] && wire_name[i+len+1] <= '9')
 					len++;
 
 				if (len > 0) {
-					string num_str = wire_name.substr(i+1, len);
-					int num = atoi(num_str.c_str()) & 0x0fffffff;
+					int num = atoi(wire_name + i+1) & 0x0fffffff;
 					blif_maxnum = std::max(blif_maxnum, num);
 				}
 			}
 		}
 
-		IdString wire_id = RTLIL::escape_id(wire_name);
+		wire_name_buf.clear();
+		if (wire_name[0] != '\\' && wire_name[0] != '$')
+			wire_name_buf += '\\';
+		wire_name_buf += wire_name;
+
+		IdString wire_id = wire_name_buf;
 		Wire *wire = module->wire(wire_id);
 
 		if (wire == nullptr)
@@ -123,16 +164,16 @@ void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool
 
 	dict<RTLIL::IdString, std::pair<int, bool>> wideports_cache;
 
-	size_t buffer_size = 4096;
-	char *buffer = (char*)malloc(buffer_size);
-	int line_count = 0;
+	BlifLineReader reader(f);
+	int &line_count = reader.line_count;
+	char *buffer;
 
 	while (1)
 	{
-		if (!read_next_line(buffer, buffer_size, line_count, f)) {
+		buffer = reader.next_line();
+		if (buffer == nullptr) {
 			if (module != nullptr)
 				goto error;
-			free(buffer);
 			return;
 		}
 
@@ -151,7 +192,9 @@ void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool
 			}
 
 			if (sopcell) {
+				sopcell->parameters[ID::DEPTH] = sop_depth;
 				sopcell = NULL;
+				sop_table = NULL;
 				sopmode = -1;
 			}
 
@@ -450,7 +493,8 @@ void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool
 				{
 					RTLIL::State state = RTLIL::State::Sa;
 					while (1) {
-						if (!read_next_line(buffer, buffer_size, line_count, f))
+						buffer = reader.next_line();
+						if (buffer == nullptr)
 							goto error;
 						for (int i = 0; buffer[i]; i++) {
 							if (buffer[i] == ' ' || buffer[i] == '\t')
@@ -491,6 +535,8 @@ void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool
 					sopcell->setPort(ID::A, input_sig);
 					sopcell->setPort(ID::Y, output_sig);
 					sopmode = -1;
+					sop_table = &sopcell->parameters.at(ID::TABLE);
+					sop_depth = 0;
 					lastcell = sopcell;
 				}
 				else
@@ -524,21 +570,22 @@ void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool
 		if (sopcell)
 		{
 			log_assert(sopcell->parameters[ID::WIDTH].as_int() == input_len);
-			sopcell->parameters[ID::DEPTH] = sopcell->parameters[ID::DEPTH].as_int() + 1;
+			sop_depth++;
 
+			std::vector<RTLIL::State> &table = sop_table->bits;
 			for (int i = 0; i < input_len; i++)
 				switch (input[i]) {
 					case '0':
-						sopcell->parameters[ID::TABLE].bits.push_back(State::S1);
-						sopcell->parameters[ID::TABLE].bits.push_back(State::S0);
+						table.push_back(State::S1);
+						table.push_back(State::S0);
 						break;
 					case '1':
-						sopcell->parameters[ID::TABLE].bits.push_back(State::S0);
-						sopcell->parameters[ID::TABLE].bits.push_back(State::S1);
+						table.push_back(State::S0);
+						table.push_back(State::S1);
 						break;
 					default:
-						sopcell->parameters[ID::TABLE].bits.push_back(State::S0);
-						sopcell->parameters[ID::TABLE].bits.push_back(State::S0);
+						table.push_back(State::S0);
+						table.push_back(State::S0);
 						break;
 				}
 
@@ -559,19 +606,25 @@ void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool
 			if (input_len > 12)
 				goto error;
 
-			for (int i = 0; i < (1 << input_len); i++) {
-				for (int j = 0; j < input_len; j++) {
-					char c1 = input[j];
-					if (c1 != '-') {
-						char c2 = (i & (1 << j)) != 0 ? '1' : '0';
-						if (c1 != c2)
-							goto try_next_value;
-					}
-				}
-				lutptr->bits.at(i) = !strcmp(output, "0") ? RTLIL::State::S0 : RTLIL::State::S1;
-			try_next_value:;
+			if ((1 << input_len) > GetSize(lutptr->bits))
+				goto error;
+
+			// The cube matches all LUT entries i with (i & care_mask) == value_mask.
+			int care_mask = 0, value_mask = 0;
+			for (int j = 0; j < input_len; j++) {
+				if (input[j] == '-')
+					continue;
+				if (input[j] != '0' && input[j] != '1')
+					goto no_matching_value;
+				care_mask |= 1 << j;
+				if (input[j] == '1')
+					value_mask |= 1 << j;
 			}
 
+			for (int i = value_mask; i < (1 << input_len); i = (((i | care_mask) + 1) & ~care_mask) | value_mask)
+				lutptr->bits[i] = !strcmp(output, "0") ? RTLIL::State::S0 : RTLIL::State::S1;
+
+		no_matching_value:
 			lut_default_state = !strcmp(output, "0") ? RTLIL::State::S1 : RTLIL::State::S0;
 		}
 	}
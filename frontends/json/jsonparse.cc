@@ -21,6 +21,8 @@
 
 YOSYS_NAMESPACE_BEGIN
 
+// JSON nodes are allocated from the arena of the JsonReader that created them, and are freed all at once
+// when the arena is cleared.
 struct JsonNode
 {
 	char type; // S=String, N=Number, A=Array, D=Dict
@@ -30,179 +32,183 @@ struct JsonNode
 	dict<string, JsonNode*> data_dict;
 	vector<string> data_dict_keys;
 
-	JsonNode(std::istream &f)
+	JsonNode() : type(0), data_number(0) {}
+};
+
+// Reads the input in large blocks instead of character by character from the stream. Only the subtree of the
+// module that is currently being imported is kept in memory, so that the memory needed for reading large files
+// is proportional to the largest module rather than to the size of the file.
+struct JsonReader
+{
+	std::istream &f;
+	std::vector<char> buffer;
+	size_t buffer_pos = 0, buffer_size = 0;
+	std::deque<JsonNode> arena;
+
+	JsonReader(std::istream &f) : f(f), buffer(1 << 16) {}
+
+	int get()
 	{
-		type = 0;
-		data_number = 0;
+		if (buffer_pos == buffer_size) {
+			f.read(buffer.data(), buffer.size());
+			buffer_pos = 0;
+			buffer_size = f.gcount();
+			if (buffer_size == 0)
+				return EOF;
+		}
+		return (unsigned char)buffer[buffer_pos++];
+	}
 
-		while (1)
-		{
-			int ch = f.get();
+	// May only be called after get() returned a character.
+	void unget()
+	{
+		buffer_pos--;
+	}
 
+	// Skips whitespace and the given separator; returns the next character, which is not consumed.
+	int skip(char separator)
+	{
+		while (1) {
+			int ch = get();
 			if (ch == EOF)
 				log_error("Unexpected EOF in JSON file.\n");
-
-			if (ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n')
+			if (ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n' || ch == separator)
 				continue;
+			unget();
+			return ch;
+		}
+	}
 
-			if (ch == '"')
-			{
-				type = 'S';
-
-				while (1)
-				{
-					ch = f.get();
-
-					if (ch == EOF)
-						log_error("Unexpected EOF in JSON string.\n");
-
-					if (ch == '"')
-						break;
-
-					if (ch == '\\') {
-						int ch = f.get();
-
-						if (ch == EOF)
-							log_error("Unexpected EOF in JSON string.\n");
-					}
+	JsonNode *parse()
+	{
+		arena.emplace_back();
+		JsonNode *node = &arena.back();
 
-					data_string += ch;
-				}
+		int ch = skip(0);
+		get();
 
-				break;
-			}
+		if (ch == '"')
+		{
+			node->type = 'S';
 
-			if ('0' <= ch && ch <= '9')
+			while (1)
 			{
-				type = 'N';
-				data_number = ch - '0';
-				data_string += ch;
-
-				while (1)
-				{
-					ch = f.get();
+				ch = get();
 
-					if (ch == EOF)
-						break;
-
-					if (ch == '.')
-						goto parse_real;
+				if (ch == EOF)
+					log_error("Unexpected EOF in JSON string.\n");
 
-					if (ch < '0' || '9' < ch) {
-						f.unget();
-						break;
-					}
+				if (ch == '"')
+					break;
 
-					data_number = data_number*10 + (ch - '0');
-					data_string += ch;
-				}
-
-				data_string = "";
-				break;
-
-			parse_real:
-				type = 'S';
-				data_number = 0;
-				data_string += ch;
-
-				while (1)
-				{
-					ch = f.get();
+				if (ch == '\\') {
+					int ch = get();
 
 					if (ch == EOF)
-						break;
-
-					if (ch < '0' || '9' < ch) {
-						f.unget();
-						break;
-					}
-
-					data_string += ch;
+						log_error("Unexpected EOF in JSON string.\n");
 				}
 
-				break;
+				node->data_string += ch;
 			}
 
-			if (ch == '[')
-			{
-				type = 'A';
+			return node;
+		}
 
-				while (1)
-				{
-					ch = f.get();
+		if ('0' <= ch && ch <= '9')
+		{
+			node->type = 'N';
+			node->data_number = ch - '0';
+			node->data_string += ch;
 
-					if (ch == EOF)
-						log_error("Unexpected EOF in JSON file.\n");
+			while (1)
+			{
+				ch = get();
 
-					if (ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n' || ch == ',')
-						continue;
+				if (ch == EOF)
+					break;
 
-					if (ch == ']')
-						break;
+				if (ch == '.')
+					goto parse_real;
 
-					f.unget();
-					data_array.push_back(new JsonNode(f));
+				if (ch < '0' || '9' < ch) {
+					unget();
+					break;
 				}
 
-				break;
+				node->data_number = node->data_number*10 + (ch - '0');
+				node->data_string += ch;
 			}
 
-			if (ch == '{')
-			{
-				type = 'D';
+			node->data_string = "";
+			return node;
 
-				while (1)
-				{
-					ch = f.get();
+		parse_real:
+			node->type = 'S';
+			node->data_number = 0;
+			node->data_string += ch;
 
-					if (ch == EOF)
-						log_error("Unexpected EOF in JSON file.\n");
+			while (1)
+			{
+				ch = get();
 
-					if (ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n' || ch == ',')
-						continue;
+				if (ch == EOF)
+					break;
 
-					if (ch == '}')
-						break;
+				if (ch < '0' || '9' < ch) {
+					unget();
+					break;
+				}
 
-					f.unget();
-					JsonNode key(f);
+				node->data_string += ch;
+			}
 
-					while (1)
-					{
-						ch = f.get();
+			return node;
+		}
 
-						if (ch == EOF)
-							log_error("Unexpected EOF in JSON file.\n");
+		if (ch == '[')
+		{
+			node->type = 'A';
 
-						if (ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n' || ch == ':')
-							continue;
+			while (skip(',') != ']')
+				node->data_array.push_back(parse());
 
-						f.unget();
-						break;
-					}
+			get();
+			return node;
+		}
 
-					JsonNode *value = new JsonNode(f);
+		if (ch == '{')
+		{
+			node->type = 'D';
 
-					if (key.type != 'S')
-						log_error("Unexpected non-string key in JSON dict.\n");
+			while (skip(',') != '}')
+			{
+				JsonNode *key = parse();
+				skip(':');
+				JsonNode *value = parse();
 
-					data_dict[key.data_string] = value;
-					data_dict_keys.push_back(key.data_string);
-				}
+				if (key->type != 'S')
+					log_error("Unexpected non-string key in JSON dict.\n");
 
-				break;
+				node->data_dict[key->data_string] = value;
+				node->data_dict_keys.push_back(key->data_string);
 			}
 
-			log_error("Unexpected character in JSON file: '%c'\n", ch);
+			get();
+			return node;
 		}
+
+		log_error("Unexpected character in JSON file: '%c'\n", ch);
 	}
 
-	~JsonNode()
+	// Parses a dict key and the following separator, returning the key.
+	string parse_key()
 	{
-		for (auto it : data_array)
-			delete it;
-		for (auto &it : data_dict)
-			delete it.second;
+		JsonNode *key = parse();
+		if (key->type != 'S')
+			log_error("Unexpected non-string key in JSON dict.\n");
+		string result = key->data_string;
+		skip(':');
+		return result;
 	}
 };
 
@@ -560,20 +566,34 @@ struct JsonFrontend : public Frontend {
 		}
 		extra_args(f, filename, args, argidx);
 
-		JsonNode root(*f);
+		JsonReader reader(*f);
 
-		if (root.type != 'D')
+		if (reader.skip(0) != '{')
 			log_error("JSON root node is not a dictionary.\n");
+		reader.get();
 
-		if (root.data_dict.count("modules") != 0)
+		while (reader.skip(',') != '}')
 		{
-			JsonNode *modules = root.data_dict.at("modules");
+			string key = reader.parse_key();
+
+			if (key != "modules") {
+				reader.parse();
+				reader.arena.clear();
+				continue;
+			}
 
-			if (modules->type != 'D')
+			if (reader.skip(0) != '{')
 				log_error("JSON modules node is not a dictionary.\n");
+			reader.get();
 
-			for (auto &it : modules->data_dict)
-				json_import(design, it.first, it.second);
+			while (reader.skip(',') != '}')
+			{
+				string modname = reader.parse_key();
+				JsonNode *module_node = reader.parse();
+				json_import(design, modname, module_node);
+				reader.arena.clear();
+			}
+			reader.get();
 		}
 	}
 } JsonFrontend;
@@ -0,0 +1,329 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *  ---
+ *
+ *  Reader for the binary RTLIL representation written by `write_rtlil -binary'.
+ *  See backends/rtlil/rtlil_backend.h for a description of the format.
+ *
+ */
+
+#include "rtlil_frontend.h"
+#include "backends/rtlil/rtlil_backend.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+namespace {
+
+struct BinaryReader
+{
+	const uint8_t *ptr, *end;
+	std::vector<RTLIL::IdString> strings;
+	std::vector<RTLIL::Wire*> wires;
+
+	BinaryReader(const std::string &data) :
+			ptr(reinterpret_cast<const uint8_t*>(data.data())), end(ptr + data.size()) {}
+
+	[[noreturn]] void error(const char *what)
+	{
+		log_error("Invalid binary RTLIL file: %s.\n", what);
+	}
+
+	uint8_t byte()
+	{
+		if (ptr == end)
+			error("unexpected end of file");
+		return *ptr++;
+	}
+
+	uint64_t varint()
+	{
+		uint64_t value = 0;
+		for (int shift = 0; shift < 64; shift += 7) {
+			uint8_t b = byte();
+			value |= uint64_t(b & 0x7f) << shift;
+			if ((b & 0x80) == 0)
+				return value;
+		}
+		error("invalid integer");
+	}
+
+	int integer()
+	{
+		uint64_t value = varint();
+		if (value > uint64_t(INT_MAX))
+			error("integer out of range");
+		return int(value);
+	}
+
+	int sinteger()
+	{
+		uint64_t value = varint();
+		int64_t result = (value & 1) ? -int64_t(value >> 1) - 1 : int64_t(value >> 1);
+		if (result < INT_MIN || result > INT_MAX)
+			error("integer out of range");
+		return int(result);
+	}
+
+	RTLIL::IdString id()
+	{
+		uint64_t ref = varint();
+		if (ref != 0) {
+			if (ref > strings.size())
+				error("invalid string reference");
+			return strings[ref - 1];
+		}
+		uint64_t size = varint();
+		if (size == 0 || size > uint64_t(end - ptr))
+			error("invalid string");
+		strings.push_back(std::string(reinterpret_cast<const char*>(ptr), size));
+		ptr += size;
+		return strings.back();
+	}
+
+	void bits(std::vector<RTLIL::State> &bits)
+	{
+		uint64_t header = varint();
+		uint64_t width = header >> 1;
+		bool defined = (header & 1) == 0;
+		int per_byte = defined ? 8 : 2;
+		if (width > uint64_t(INT_MAX) || (width + per_byte - 1) / per_byte > uint64_t(end - ptr))
+			error("invalid constant");
+		bits.resize(width);
+		for (uint64_t i = 0; i < width; i += per_byte) {
+			uint8_t packed = *ptr++;
+			for (uint64_t j = 0; j < uint64_t(per_byte) && i + j < width; j++) {
+				uint8_t state = defined ? (packed >> j) & 1 : (packed >> (4 * j)) & 15;
+				if (state > RTLIL::Sm)
+					error("invalid state");
+				bits[i + j] = RTLIL::State(state);
+			}
+		}
+	}
+
+	RTLIL::Const constant()
+	{
+		RTLIL::Const value;
+		value.flags = integer();
+		bits(value.bits);
+		return value;
+	}
+
+	void attributes(RTLIL::AttrObject *obj)
+	{
+		// The writer emits attributes in dict iteration order, which is the reverse of insertion order.
+		std::vector<std::pair<RTLIL::IdString, RTLIL::Const>> attrs;
+		for (int count = integer(); count > 0; count--) {
+			RTLIL::IdString name = id();
+			attrs.emplace_back(name, constant());
+		}
+		for (auto it = attrs.rbegin(); it != attrs.rend(); ++it)
+			obj->attributes[it->first] = std::move(it->second);
+	}
+
+	RTLIL::SigSpec sigspec()
+	{
+		RTLIL::SigSpec sig;
+		for (int count = integer(); count > 0; count--) {
+			uint64_t wire_ref = varint();
+			if (wire_ref == 0) {
+				RTLIL::Const value;
+				bits(value.bits);
+				sig.append(value);
+			} else {
+				if (wire_ref > wires.size())
+					error("invalid wire reference");
+				RTLIL::Wire *wire = wires[wire_ref - 1];
+				int offset = integer();
+				int width = integer();
+				if (width == 0 || offset + int64_t(width) > wire->width)
+					error("invalid wire slice");
+				sig.append(RTLIL::SigSpec(wire, offset, width));
+			}
+		}
+		return sig;
+	}
+
+	RTLIL::SigSig sigsig()
+	{
+		RTLIL::SigSpec first = sigspec();
+		RTLIL::SigSpec second = sigspec();
+		return RTLIL::SigSig(first, second);
+	}
+
+	void case_rule(RTLIL::CaseRule *cs)
+	{
+		attributes(cs);
+		for (int count = integer(); count > 0; count--)
+			cs->compare.push_back(sigspec());
+		for (int count = integer(); count > 0; count--)
+			cs->actions.push_back(sigsig());
+		for (int count = integer(); count > 0; count--) {
+			RTLIL::SwitchRule *sw = new RTLIL::SwitchRule;
+			cs->switches.push_back(sw);
+			attributes(sw);
+			sw->signal = sigspec();
+			for (int count = integer(); count > 0; count--) {
+				RTLIL::CaseRule *child = new RTLIL::CaseRule;
+				sw->cases.push_back(child);
+				case_rule(child);
+			}
+		}
+	}
+
+	void module(RTLIL::Design *design)
+	{
+		RTLIL::Module *module = new RTLIL::Module;
+		module->name = id();
+		attributes(module);
+
+		bool delete_module = false;
+		if (design->has(module->name)) {
+			RTLIL::Module *existing_mod = design->module(module->name);
+			if (!RTLIL_FRONTEND::flag_overwrite && (RTLIL_FRONTEND::flag_lib || module->get_bool_attribute(ID::blackbox))) {
+				log("Ignoring blackbox re-definition of module %s.\n", log_id(module));
+				delete_module = true;
+			} else if (!RTLIL_FRONTEND::flag_nooverwrite && !RTLIL_FRONTEND::flag_overwrite && !existing_mod->get_bool_attribute(ID::blackbox)) {
+				log_error("RTLIL error: redefinition of module %s.\n", log_id(module));
+			} else if (RTLIL_FRONTEND::flag_nooverwrite) {
+				log("Ignoring re-definition of module %s.\n", log_id(module));
+				delete_module = true;
+			} else {
+				log("Replacing existing%s module %s.\n", existing_mod->get_bool_attribute(ID::blackbox) ? " blackbox" : "", log_id(module));
+				design->remove(existing_mod);
+			}
+		}
+		if (!delete_module)
+			design->add(module);
+
+		for (int count = integer(); count > 0; count--) {
+			RTLIL::IdString param = id();
+			module->avail_parameters(param);
+			if (byte())
+				module->parameter_default_values[param] = constant();
+		}
+
+		wires.clear();
+		for (int count = integer(); count > 0; count--) {
+			RTLIL::IdString name = id();
+			if (module->wire(name) != nullptr)
+				log_error("RTLIL error: redefinition of wire %s.\n", log_id(name));
+			RTLIL::Wire *wire = module->addWire(name);
+			wires.push_back(wire);
+			attributes(wire);
+			wire->width = integer();
+			wire->start_offset = sinteger();
+			wire->port_id = integer();
+			uint8_t flags = byte();
+			wire->port_input = (flags & 1) != 0;
+			wire->port_output = (flags & 2) != 0;
+			wire->upto = (flags & 4) != 0;
+			wire->is_signed = (flags & 8) != 0;
+		}
+
+		for (int count = integer(); count > 0; count--) {
+			RTLIL::IdString name = id();
+			if (module->memories.count(name) != 0)
+				log_error("RTLIL error: redefinition of memory %s.\n", log_id(name));
+			RTLIL::Memory *memory = new RTLIL::Memory;
+			memory->name = name;
+			module->memories[name] = memory;
+			attributes(memory);
+			memory->width = integer();
+			memory->size = integer();
+			memory->start_offset = sinteger();
+		}
+
+		for (int count = integer(); count > 0; count--) {
+			RTLIL::IdString name = id();
+			RTLIL::IdString type = id();
+			if (module->cell(name) != nullptr)
+				log_error("RTLIL error: redefinition of cell %s.\n", log_id(name));
+			RTLIL::Cell *cell = module->addCell(name, type);
+			attributes(cell);
+			for (int count = integer(); count > 0; count--) {
+				RTLIL::IdString param = id();
+				cell->parameters[param] = constant();
+			}
+			for (int count = integer(); count > 0; count--) {
+				RTLIL::IdString port = id();
+				cell->setPort(port, sigspec());
+			}
+		}
+
+		for (int count = integer(); count > 0; count--) {
+			RTLIL::IdString name = id();
+			if (module->processes.count(name) != 0)
+				log_error("RTLIL error: redefinition of process %s.\n", log_id(name));
+			RTLIL::Process *proc = new RTLIL::Process;
+			proc->name = name;
+			module->processes[name] = proc;
+			attributes(proc);
+			case_rule(&proc->root_case);
+			for (int count = integer(); count > 0; count--) {
+				RTLIL::SyncRule *sync = new RTLIL::SyncRule;
+				proc->syncs.push_back(sync);
+				uint8_t type = byte();
+				if (type > RTLIL::STi)
+					error("invalid sync type");
+				sync->type = RTLIL::SyncType(type);
+				sync->signal = sigspec();
+				for (int count = integer(); count > 0; count--)
+					sync->actions.push_back(sigsig());
+			}
+		}
+
+		for (int count = integer(); count > 0; count--)
+			module->connect(sigsig());
+
+		module->fixup_ports();
+		if (delete_module)
+			delete module;
+		else if (RTLIL_FRONTEND::flag_lib)
+			module->makeblackbox();
+	}
+};
+
+}
+
+bool RTLIL_FRONTEND::is_binary(std::istream &f)
+{
+	return f.peek() == (unsigned char)RTLIL_BACKEND::binary_magic[0];
+}
+
+void RTLIL_FRONTEND::read_binary(std::istream &f, RTLIL::Design *design)
+{
+	std::string data;
+	char buffer[65536];
+	while (f.read(buffer, sizeof(buffer)) || f.gcount() > 0)
+		data.append(buffer, f.gcount());
+
+	if (data.compare(0, RTLIL_BACKEND::binary_magic_size, RTLIL_BACKEND::binary_magic, RTLIL_BACKEND::binary_magic_size) != 0)
+		log_error("Invalid binary RTLIL file: bad magic.\n");
+
+	BinaryReader reader(data);
+	reader.ptr += RTLIL_BACKEND::binary_magic_size;
+	if (reader.varint() != uint64_t(RTLIL_BACKEND::binary_version))
+		log_error("Unsupported binary RTLIL file version.\n");
+	autoidx = std::max(autoidx, reader.integer());
+	for (int count = reader.integer(); count > 0; count--)
+		reader.module(design);
+	if (reader.ptr != reader.end)
+		reader.error("trailing data");
+}
+
+YOSYS_NAMESPACE_END
@@ -42,7 +42,8 @@ struct RTLILFrontend : public Frontend {
 		log("    read_rtlil [filename]\n");
 		log("\n");
 		log("Load modules from an RTLIL file to the current design. (RTLIL is a text\n");
-		log("representation of a design in yosys's internal format.)\n");
+		log("representation of a design in yosys's internal format.) Files written with\n");
+		log("`write_rtlil -binary' are detected and read automatically.\n");
 		log("\n");
 		log("    -nooverwrite\n");
 		log("        ignore re-definitions of modules. (the default behavior is to\n");
@@ -83,10 +84,15 @@ struct RTLILFrontend : public Frontend {
 			}
 			break;
 		}
-		extra_args(f, filename, args, argidx);
+		extra_args(f, filename, args, argidx, /*bin_input=*/true);
 
 		log("Input filename: %s\n", filename.c_str());
 
+		if (RTLIL_FRONTEND::is_binary(*f)) {
+			RTLIL_FRONTEND::read_binary(*f, design);
+			return;
+		}
+
 		RTLIL_FRONTEND::lexin = f;
 		RTLIL_FRONTEND::current_design = design;
 		rtlil_frontend_yydebug = false;
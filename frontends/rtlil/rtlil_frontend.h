@@ -35,6 +35,10 @@ namespace RTLIL_FRONTEND {
 	extern bool flag_nooverwrite;
 	extern bool flag_overwrite;
 	extern bool flag_lib;
+
+	// Binary RTLIL, see backends/rtlil/rtlil_backend.h.
+	bool is_binary(std::istream &f);
+	void read_binary(std::istream &f, RTLIL::Design *design);
 }
 
 YOSYS_NAMESPACE_END
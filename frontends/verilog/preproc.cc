@@ -43,41 +43,51 @@
 YOSYS_NAMESPACE_BEGIN
 using namespace VERILOG_FRONTEND;
 
-static std::list<std::string> output_code;
-static std::list<std::string> input_buffer;
-static size_t input_buffer_charp;
+// The input is kept as a stack of segments: the contents of each input file and the body of each expanded
+// macro is pushed as one segment, and characters are read from the segment at the top of the stack until
+// it is exhausted. This way, pushing back characters and inserting macro expansions never copies the
+// remaining input.
+struct input_segment_t
+{
+	std::string text;
+	size_t pos;
+};
+
+static std::string output_code;
+static std::vector<input_segment_t> input_stack;
 
 static void return_char(char ch)
 {
-	if (input_buffer_charp == 0)
-		input_buffer.push_front(std::string() + ch);
-	else
-		input_buffer.front()[--input_buffer_charp] = ch;
+	if (input_stack.empty() || input_stack.back().pos == 0)
+		input_stack.push_back({std::string(1, ch), 0});
+	else {
+		input_segment_t &segment = input_stack.back();
+		segment.text[--segment.pos] = ch;
+	}
 }
 
 static void insert_input(std::string str)
 {
-	if (input_buffer_charp != 0) {
-		input_buffer.front() = input_buffer.front().substr(input_buffer_charp);
-		input_buffer_charp = 0;
-	}
-	input_buffer.push_front(str);
+	if (!str.empty())
+		input_stack.push_back({std::move(str), 0});
+}
+
+static bool input_exhausted()
+{
+	while (!input_stack.empty() && input_stack.back().pos == input_stack.back().text.size())
+		input_stack.pop_back();
+	return input_stack.empty();
 }
 
 static char next_char()
 {
-	if (input_buffer.empty())
-		return 0;
-
-	log_assert(input_buffer_charp <= input_buffer.front().size());
-	if (input_buffer_charp == input_buffer.front().size()) {
-		input_buffer_charp = 0;
-		input_buffer.pop_front();
-		return next_char();
+	while (!input_exhausted()) {
+		input_segment_t &segment = input_stack.back();
+		char ch = segment.text[segment.pos++];
+		if (ch != '\r')
+			return ch;
 	}
-
-	char ch = input_buffer.front()[input_buffer_charp++];
-	return ch == '\r' ? next_char() : ch;
+	return 0;
 }
 
 static std::string skip_spaces()
@@ -107,7 +117,7 @@ static std::string next_token(bool pass_newline = false)
 	token += ch;
 	if (ch == '\n') {
 		if (pass_newline) {
-			output_code.push_back(token);
+			output_code += token;
 			return "";
 		}
 		return token;
@@ -362,9 +372,12 @@ void define_map_t::clear()
 
 void define_map_t::log() const
 {
-	for (auto &it : defines) {
-		const std::string &name = it.first;
-		const define_body_t &body = *it.second;
+	std::vector<std::string> names;
+	for (auto &it : defines)
+		names.push_back(it.first);
+	std::sort(names.begin(), names.end());
+	for (auto &name : names) {
+		const define_body_t &body = *defines.at(name);
 		Yosys::log("`define %s%s %s\n",
 		           name.c_str(), body.has_args ? "()" : "", body.body.c_str());
 	}
@@ -372,18 +385,15 @@ void define_map_t::log() const
 
 static void input_file(std::istream &f, std::string filename)
 {
-	char buffer[513];
-	int rc;
-
-	insert_input("");
-	auto it = input_buffer.begin();
-
-	input_buffer.insert(it, "`file_push \"" + filename + "\"\n");
-	while ((rc = readsome(f, buffer, sizeof(buffer)-1)) > 0) {
-		buffer[rc] = 0;
-		input_buffer.insert(it, buffer);
-	}
-	input_buffer.insert(it, "\n`file_pop\n");
+	std::string text = "`file_push \"" + filename + "\"\n";
+	std::ostringstream contents;
+	if (f.peek() != EOF)
+		contents << f.rdbuf();
+	text += contents.str();
+	// NUL characters would be mistaken for the end of the input.
+	text.erase(std::remove(text.begin(), text.end(), '\0'), text.end());
+	text += "\n`file_pop\n";
+	insert_input(std::move(text));
 }
 
 // Read tokens to get one argument (either a macro argument at a callsite or a default argument in a
@@ -443,7 +453,7 @@ static bool try_expand_macro(define_map_t &defines, std::string &tok)
 	if (tok == "`\"") {
 		std::string literal("\"");
 		// Expand string literal
-		while (!input_buffer.empty()) {
+		while (!input_exhausted()) {
 			std::string ntok = next_token();
 			if (ntok == "`\"") {
 				insert_input(literal+"\"");
@@ -464,15 +474,14 @@ static bool try_expand_macro(define_map_t &defines, std::string &tok)
 		return false;
 
 	// This token looks like a macro name (`foo).
-	std::string macro_name = tok.substr(1);
-	const define_body_t *body = defines.find(tok.substr(1));
+	std::string name = tok.substr(1);
+	const define_body_t *body = defines.find(name);
 
 	if (! body) {
 		// Apparently not a name we know.
 		return false;
 	}
 
-	std::string name = tok.substr(1);
 	std::string skipped_spaces = skip_spaces();
 	tok = next_token(false);
 	if (tok == "(" && body->has_args) {
@@ -719,16 +728,25 @@ frontend_verilog_preproc(std::istream                 &f,
 	bool in_elseif = false;
 
 	output_code.clear();
-	input_buffer.clear();
-	input_buffer_charp = 0;
+	input_stack.clear();
 
 	input_file(f, filename);
 
-	while (!input_buffer.empty())
+	while (!input_exhausted())
 	{
 		std::string tok = next_token();
 		// printf("token: >>%s<<\n", tok != "\n" ? tok.c_str() : "NEWLINE");
 
+		// Only tokens starting with a backtick can be directives or macros; everything else is copied to
+		// the output (unless it is in a failed `ifdef block) without comparing it against every directive.
+		bool maybe_directive = tok.size() > 1 && tok[0] == '`';
+
+		if (!maybe_directive) {
+			if (ifdef_fail_level == 0 || tok == "\n")
+				output_code += tok;
+			continue;
+		}
+
 		if (tok == "`endif") {
 			if (ifdef_fail_level > 0)
 				ifdef_fail_level--;
@@ -771,11 +789,8 @@ frontend_verilog_preproc(std::istream                 &f,
 			continue;
 		}
 
-		if (ifdef_fail_level > 0) {
-			if (tok == "\n")
-				output_code.push_back(tok);
+		if (ifdef_fail_level > 0)
 			continue;
-		}
 
 		if (tok == "`include") {
 			skip_spaces();
@@ -831,7 +846,7 @@ frontend_verilog_preproc(std::istream                 &f,
 				}
 			}
 			if (ff.fail()) {
-				output_code.push_back("`file_notfound " + fn);
+				output_code += "`file_notfound " + fn;
 			} else {
 				input_file(ff, fixed_fn);
 				yosys_input_files.insert(fixed_fn);
@@ -844,14 +859,14 @@ frontend_verilog_preproc(std::istream                 &f,
 			std::string fn = next_token(true);
 			if (!fn.empty() && fn.front() == '"' && fn.back() == '"')
 				fn = fn.substr(1, fn.size()-2);
-			output_code.push_back(tok + " \"" + fn + "\"");
+			output_code += tok + " \"" + fn + "\"";
 			filename_stack.push_back(filename);
 			filename = fn;
 			continue;
 		}
 
 		if (tok == "`file_pop") {
-			output_code.push_back(tok);
+			output_code += tok;
 			filename = filename_stack.back();
 			filename_stack.pop_back();
 			continue;
@@ -890,16 +905,12 @@ frontend_verilog_preproc(std::istream                 &f,
 		if (try_expand_macro(defines, tok))
 			continue;
 
-		output_code.push_back(tok);
+		output_code += tok;
 	}
 
 	std::string output;
-	for (auto &str : output_code)
-		output += str;
-
-	output_code.clear();
-	input_buffer.clear();
-	input_buffer_charp = 0;
+	output.swap(output_code);
+	input_stack.clear();
 
 	return output;
 }
@@ -59,7 +59,7 @@ struct define_map_t
 	// Print a list of definitions, using the log function
 	void log() const;
 
-	std::map<std::string, std::unique_ptr<define_body_t>> defines;
+	dict<std::string, std::unique_ptr<define_body_t>> defines;
 };
 
 
@@ -29,6 +29,7 @@
 #include "verilog_frontend.h"
 #include "preproc.h"
 #include "kernel/yosys.h"
+#include "kernel/threading.h"
 #include "libs/sha1/sha1.h"
 #include <stdarg.h>
 
@@ -37,9 +38,209 @@ using namespace VERILOG_FRONTEND;
 
 // use the Verilog bison/flex parser to generate an AST and use AST::process() to convert it to RTLIL
 
-static std::vector<std::string> verilog_defaults;
+std::vector<std::string> verilog_defaults;
 static std::list<std::vector<std::string>> verilog_defaults_stack;
 
+#ifdef YOSYS_ENABLE_THREADS
+// When several files are given to read_verilog, the frontend is invoked once per file, and each file is
+// preprocessed, parsed and converted to RTLIL in order (defines and packages carry over from one file to
+// the next, and neither the parser nor the AST library are reentrant). The files that will be read by the
+// following invocations are loaded by worker threads in the meantime, so that reading from disk overlaps
+// with parsing.
+struct VerilogPrefetcher
+{
+	enum state_t { PENDING, LOADED, FAILED, CONSUMED };
+
+	std::vector<std::string> filenames;
+	std::vector<std::string> contents;
+	std::vector<state_t> states;
+	int next_job = 0;
+
+	std::mutex mutex;
+	std::condition_variable loaded;
+	std::unique_ptr<ThreadPool> pool;
+
+	VerilogPrefetcher(const std::vector<std::string> &filenames, int pool_size) :
+			filenames(filenames), contents(filenames.size()), states(filenames.size(), PENDING)
+	{
+		pool.reset(new ThreadPool(pool_size, [this](int) { run(); }));
+	}
+
+	~VerilogPrefetcher()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		next_job = GetSize(filenames);
+		lock.unlock();
+		pool.reset();
+	}
+
+	void run()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		while (next_job < GetSize(filenames)) {
+			int index = next_job++;
+			lock.unlock();
+			std::ifstream f(filenames[index]);
+			std::ostringstream buffer;
+			bool ok = !f.fail() && (buffer << f.rdbuf(), !f.bad());
+			std::string content = buffer.str();
+			lock.lock();
+			contents[index] = std::move(content);
+			states[index] = ok ? LOADED : FAILED;
+			loaded.notify_all();
+		}
+	}
+
+	// Returns false if the file was not prefetched (or could not be read), in which case it must be read
+	// by the caller as usual.
+	bool take(const std::string &filename, std::string &content)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		for (int index = 0; index < GetSize(filenames); index++) {
+			if (filenames[index] != filename || states[index] == CONSUMED)
+				continue;
+			loaded.wait(lock, [&] { return states[index] != PENDING; });
+			bool ok = states[index] == LOADED;
+			content = std::move(contents[index]);
+			contents[index].clear();
+			states[index] = CONSUMED;
+			return ok;
+		}
+		return false;
+	}
+};
+
+static std::unique_ptr<VerilogPrefetcher> verilog_prefetcher;
+
+// Replaces `f` with the prefetched contents of `filename` if they are available, and starts prefetching
+// the remaining files of the command line if this is the first of several files.
+static void prefetch_input(std::istream *&f, const std::string &filename, const std::vector<std::string> &next_args, size_t argidx)
+{
+	std::string content;
+	if (verilog_prefetcher != nullptr && verilog_prefetcher->take(filename, content)) {
+		// gzip compressed files have already been decompressed by extra_args().
+		if (content.compare(0, 2, "\x1f\x8b") != 0) {
+			delete f;
+			f = new std::istringstream(content);
+		}
+	} else {
+		verilog_prefetcher.reset();
+		std::vector<std::string> filenames;
+		for (size_t i = argidx; i < next_args.size(); i++) {
+			std::string next_filename = next_args[i];
+			if (next_filename.compare(0, 2, "<<") == 0)
+				break;
+			if (next_filename.find_first_of("*?[") != std::string::npos)
+				continue;
+			rewrite_filename(next_filename);
+			filenames.push_back(next_filename);
+		}
+		int pool_size = ThreadPool::pool_size(1, 4);
+		if (!filenames.empty() && pool_size > 0)
+			verilog_prefetcher.reset(new VerilogPrefetcher(filenames, pool_size));
+	}
+
+	if (next_args.empty())
+		verilog_prefetcher.reset();
+}
+#endif
+
+// State of `read_verilog -incremental'. For every file that was read, pristine copies of the modules, packages
+// and global declarations created from it are kept (before `hierarchy' or any other pass modified them),
+// together with a hash of the preprocessed code and of everything else that affects how the file is parsed.
+struct VerilogIncrementalFile
+{
+	std::string key;
+	std::vector<std::unique_ptr<RTLIL::Module>> modules;
+	std::vector<std::unique_ptr<AST::AstNode>> packages, globals;
+	int autoidx;
+};
+
+static dict<std::string, std::unique_ptr<VerilogIncrementalFile>> verilog_incremental_files;
+
+static std::string verilog_incremental_key(const std::vector<std::string> &args, size_t argidx, const std::string &code, RTLIL::Design *design)
+{
+	std::string data;
+	for (size_t i = 1; i < argidx; i++)
+		data += args[i] + " ";
+	data += "\n";
+	// Packages and global declarations read from earlier files are copied into every module.
+	for (auto node : design->verilog_packages)
+		AST::serialize_ast(node, data);
+	for (auto node : design->verilog_globals)
+		AST::serialize_ast(node, data);
+	data += "\n";
+	data += code;
+	return sha1(data);
+}
+
+// AstModule::derive_common() names modules with long parameter lists "$paramod$" followed by the SHA1 of the
+// parameters as hex digits (two per byte of the 20 byte digest) and then the escaped name of the base module.
+static const char paramod_hash_prefix[] = "$paramod$";
+static const size_t paramod_hash_digits = 2 * 20;
+static const size_t paramod_hash_base_pos = sizeof(paramod_hash_prefix) - 1 + paramod_hash_digits;
+
+// Returns the name of the module that `name' was derived from by `hierarchy', or an empty string.
+static std::string derived_base_name(const std::string &name)
+{
+	if (name.compare(0, sizeof(paramod_hash_prefix) - 1, paramod_hash_prefix) == 0) {
+		if (name.size() > paramod_hash_base_pos && name[paramod_hash_base_pos] == '\\')
+			return name.substr(paramod_hash_base_pos);
+		return std::string();
+	}
+	if (name.compare(0, 9, "$paramod\\") == 0)
+		return name.substr(8, name.find('\\', 9) - 8);
+	return std::string();
+}
+
+// Removes the modules that were created from a file that is about to be read again. Modules derived from them
+// are removed as well, and modules that instantiate any removed module are restored to their pristine copies
+// (if they were read with -incremental), so that the next `hierarchy' elaborates them again.
+static void remove_incremental_modules(RTLIL::Design *design, const VerilogIncrementalFile &file)
+{
+	// Modules are considered removed even if they are no longer in the design (e.g. `hierarchy -top' dropped an
+	// abstract parametric module after deriving it), so that the modules depending on them are still found.
+	pool<RTLIL::IdString> removed;
+	for (auto &mod : file.modules) {
+		if (design->has(mod->name))
+			design->remove(design->module(mod->name));
+		removed.insert(mod->name);
+	}
+
+	dict<RTLIL::IdString, const RTLIL::Module*> pristine;
+	for (auto &it : verilog_incremental_files)
+		for (auto &mod : it.second->modules)
+			pristine[mod->name] = mod.get();
+
+	pool<RTLIL::IdString> restored;
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		for (auto module : design->modules().to_vector()) {
+			if (restored.count(module->name))
+				continue;
+			std::string base = derived_base_name(module->name.str());
+			bool stale = !base.empty() && (removed.count(base) || removed.count("$abstract" + base));
+			for (auto cell : module->cells())
+				stale = stale || removed.count(cell->type);
+			if (!stale)
+				continue;
+			if (!base.empty() || !pristine.count(module->name)) {
+				log("Removing module `%s', which depends on a changed module.\n", log_id(module));
+				removed.insert(module->name);
+				design->remove(module);
+			} else {
+				log("Restoring module `%s' for re-elaboration, as it instantiates a changed module.\n", log_id(module));
+				RTLIL::Module *copy = pristine.at(module->name)->clone();
+				design->remove(module);
+				design->add(copy);
+				restored.insert(copy->name);
+			}
+			changed = true;
+		}
+	}
+}
+
 static void error_on_dpi_function(AST::AstNode *node)
 {
 	if (node->type == AST::AST_DPI_FUNCTION)
@@ -202,6 +403,17 @@ struct VerilogFrontend : public Frontend {
 		log("        to a later 'hierarchy' command. Useful in cases where the default\n");
 		log("        parameters of modules yield invalid or not synthesizable code.\n");
 		log("\n");
+		log("    -incremental\n");
+		log("        keep a copy of the modules read from the file, together with a hash\n");
+		log("        of its preprocessed contents and of the options and packages it was\n");
+		log("        read with. when the file is read again with -incremental and none of\n");
+		log("        these have changed, the copies are added to the design instead of\n");
+		log("        parsing the file again (modules that already exist in the design are\n");
+		log("        kept). when the file has changed, the modules previously read from it\n");
+		log("        and the modules derived from them are removed before it is parsed,\n");
+		log("        and modules instantiating them are restored to the state in which\n");
+		log("        they were read, so that the next 'hierarchy' elaborates them again.\n");
+		log("\n");
 		log("    -noautowire\n");
 		log("        make the default of `default_nettype be \"none\" instead of \"wire\".\n");
 		log("\n");
@@ -233,6 +445,22 @@ struct VerilogFrontend : public Frontend {
 		log("\n");
 	}
 	void execute(std::istream *&f, std::string filename, std::vector<std::string> args, RTLIL::Design *design) override
+	{
+#ifdef YOSYS_ENABLE_THREADS
+		try {
+			execute_file(f, filename, args, design);
+		} catch (...) {
+			// A command error (e.g. in the interactive shell) aborts the read_verilog command, so the files
+			// prefetched for it must not be used by a later command.
+			verilog_prefetcher.reset();
+			throw;
+		}
+#else
+		execute_file(f, filename, args, design);
+#endif
+	}
+
+	void execute_file(std::istream *&f, std::string filename, std::vector<std::string> args, RTLIL::Design *design)
 	{
 		bool flag_dump_ast1 = false;
 		bool flag_dump_ast2 = false;
@@ -253,6 +481,7 @@ struct VerilogFrontend : public Frontend {
 		bool flag_nooverwrite = false;
 		bool flag_overwrite = false;
 		bool flag_defer = false;
+		bool flag_incremental = false;
 		bool flag_noblackbox = false;
 		bool flag_nowb = false;
 		define_map_t defines_map;
@@ -409,6 +638,10 @@ struct VerilogFrontend : public Frontend {
 				flag_defer = true;
 				continue;
 			}
+			if (arg == "-incremental") {
+				flag_incremental = true;
+				continue;
+			}
 			if (arg == "-noautowire") {
 				default_nettype_wire = false;
 				continue;
@@ -447,6 +680,9 @@ struct VerilogFrontend : public Frontend {
 			break;
 		}
 		extra_args(f, filename, args, argidx);
+#ifdef YOSYS_ENABLE_THREADS
+		prefetch_input(f, filename, next_args, argidx);
+#endif
 
 		log_header(design, "Executing Verilog-2005 frontend: %s\n", filename.c_str());
 
@@ -469,6 +705,49 @@ struct VerilogFrontend : public Frontend {
 			lexin = new std::istringstream(code_after_preproc);
 		}
 
+		std::string incremental_key;
+		size_t old_packages = 0, old_globals = 0;
+		if (flag_incremental) {
+			if (flag_nopp) {
+				std::ostringstream buffer;
+				buffer << f->rdbuf();
+				code_after_preproc = buffer.str();
+				lexin = new std::istringstream(code_after_preproc);
+			}
+			incremental_key = verilog_incremental_key(args, argidx, code_after_preproc, design);
+
+			auto it = verilog_incremental_files.find(filename);
+			if (it != verilog_incremental_files.end() && it->second->key == incremental_key) {
+				const VerilogIncrementalFile &file = *it->second;
+				log("File `%s' is unchanged, using the modules read from it before.\n", filename.c_str());
+				for (auto &mod : file.modules) {
+					if (design->has(mod->name))
+						log("Keeping existing module `%s'.\n", log_id(mod->name));
+					else
+						design->add(mod->clone());
+				}
+				for (auto &node : file.packages)
+					design->verilog_packages.push_back(node->clone());
+				for (auto &node : file.globals)
+					design->verilog_globals.push_back(node->clone());
+				autoidx = std::max(autoidx, file.autoidx);
+
+				delete lexin;
+				delete current_ast;
+				current_ast = NULL;
+				log("Successfully finished Verilog frontend.\n");
+				return;
+			}
+			if (it != verilog_incremental_files.end()) {
+				log("File `%s' has changed, replacing the modules read from it before.\n", filename.c_str());
+				remove_incremental_modules(design, *it->second);
+				verilog_incremental_files.erase(it);
+			}
+
+			old_packages = design->verilog_packages.size();
+			old_globals = design->verilog_globals.size();
+		}
+
 		// make package typedefs available to parser
 		add_package_types(pkg_user_types, design->verilog_packages);
 
@@ -487,11 +766,43 @@ struct VerilogFrontend : public Frontend {
 		if (flag_nodpi)
 			error_on_dpi_function(current_ast);
 
+		// Files with references to other files (such as memory initialization files) are never cached.
+		std::string ast_data;
+		bool cacheable = flag_incremental && AST::serialize_ast(current_ast, ast_data);
+		std::vector<RTLIL::IdString> new_modules;
+		if (cacheable) {
+			for (auto child : current_ast->children) {
+				if (child->type != AST::AST_MODULE && child->type != AST::AST_INTERFACE)
+					continue;
+				std::string name = child->str;
+				if (flag_icells && name.compare(0, 2, "\\$") == 0)
+					name = name.substr(1);
+				if (flag_defer)
+					name = "$abstract" + name;
+				if (!flag_nooverwrite || !design->has(name))
+					new_modules.push_back(name);
+			}
+		}
+
 		AST::process(design, current_ast, flag_dump_ast1, flag_dump_ast2, flag_no_dump_ptr, flag_dump_vlog1, flag_dump_vlog2, flag_dump_rtlil, flag_nolatches,
 				flag_nomeminit, flag_nomem2reg, flag_mem2reg, flag_noblackbox, lib_mode, flag_nowb, flag_noopt, flag_icells, flag_pwires, flag_nooverwrite, flag_overwrite, flag_defer, default_nettype_wire);
 
+		if (cacheable) {
+			std::unique_ptr<VerilogIncrementalFile> file(new VerilogIncrementalFile);
+			file->key = incremental_key;
+			for (auto name : new_modules)
+				if (design->has(name))
+					file->modules.emplace_back(design->module(name)->clone());
+			for (size_t i = old_packages; i < design->verilog_packages.size(); i++)
+				file->packages.emplace_back(design->verilog_packages[i]->clone());
+			for (size_t i = old_globals; i < design->verilog_globals.size(); i++)
+				file->globals.emplace_back(design->verilog_globals[i]->clone());
+			file->autoidx = autoidx;
+			verilog_incremental_files[filename] = std::move(file);
+		}
+
 
-		if (!flag_nopp)
+		if (!flag_nopp || flag_incremental)
 			delete lexin;
 
 		delete current_ast;
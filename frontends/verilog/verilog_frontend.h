@@ -86,6 +86,9 @@ namespace VERILOG_FRONTEND
 	extern std::istream *lexin;
 }
 
+// options registered with the verilog_defaults command
+extern std::vector<std::string> verilog_defaults;
+
 YOSYS_NAMESPACE_END
 
 // the usual bison/flex stuff
@@ -0,0 +1,197 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "kernel/aiggraph.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+const AigGraph::Lit AigGraph::LIT_FALSE;
+const AigGraph::Lit AigGraph::LIT_TRUE;
+const AigGraph::Lit AigGraph::LIT_NONE;
+
+static inline int64_t strash_key(AigGraph::Lit a, AigGraph::Lit b)
+{
+	return int64_t(uint64_t(a) << 32 | b);
+}
+
+AigGraph::AigGraph()
+{
+	fanin0.push_back(LIT_NONE);
+	fanin1.push_back(LIT_NONE);
+}
+
+AigGraph::Lit AigGraph::add_input()
+{
+	inputs.push_back(size());
+	fanin0.push_back(LIT_NONE);
+	fanin1.push_back(LIT_NONE);
+	return make_lit(inputs.back());
+}
+
+int AigGraph::add_output(Lit lit)
+{
+	log_assert(node(lit) < size());
+	outputs.push_back(lit);
+	return GetSize(outputs) - 1;
+}
+
+AigGraph::Lit AigGraph::trivial_and(Lit &a, Lit &b)
+{
+	if (a > b)
+		std::swap(a, b);
+	if (a == LIT_FALSE)
+		return LIT_FALSE;
+	if (a == LIT_TRUE)
+		return b;
+	if (a == b)
+		return a;
+	if (a == lit_not(b))
+		return LIT_FALSE;
+	return LIT_NONE;
+}
+
+AigGraph::Lit AigGraph::add_and(Lit a, Lit b)
+{
+	Lit result = trivial_and(a, b);
+	if (result != LIT_NONE)
+		return result;
+
+	log_assert(node(b) < size());
+	auto it = strash.find(strash_key(a, b));
+	if (it != strash.end())
+		return make_lit(it->second);
+
+	int n = size();
+	fanin0.push_back(a);
+	fanin1.push_back(b);
+	strash[strash_key(a, b)] = n;
+	return make_lit(n);
+}
+
+AigGraph::Lit AigGraph::lookup_and(Lit a, Lit b) const
+{
+	Lit result = trivial_and(a, b);
+	if (result != LIT_NONE)
+		return result;
+
+	auto it = strash.find(strash_key(a, b));
+	if (it != strash.end())
+		return make_lit(it->second);
+	return LIT_NONE;
+}
+
+AigGraph::Lit AigGraph::add_xor(Lit a, Lit b)
+{
+	return add_or(add_and(a, lit_not(b)), add_and(lit_not(a), b));
+}
+
+AigGraph::Lit AigGraph::add_mux(Lit a, Lit b, Lit s)
+{
+	return add_or(add_and(lit_not(s), a), add_and(s, b));
+}
+
+void AigGraph::rollback(int n)
+{
+	log_assert(n > 0 && n <= size());
+	for (int i = n; i < size(); i++) {
+		if (is_and(i))
+			strash.erase(strash_key(fanin0[i], fanin1[i]));
+		else
+			inputs.pop_back();
+	}
+	fanin0.resize(n);
+	fanin1.resize(n);
+}
+
+std::vector<int> AigGraph::fanout_counts() const
+{
+	std::vector<int> counts(size());
+	for (int i = 0; i < size(); i++)
+		if (is_and(i)) {
+			counts[node(fanin0[i])]++;
+			counts[node(fanin1[i])]++;
+		}
+	for (auto lit : outputs)
+		counts[node(lit)]++;
+	return counts;
+}
+
+std::vector<int> AigGraph::levels() const
+{
+	std::vector<int> result(size());
+	for (int i = 0; i < size(); i++)
+		if (is_and(i))
+			result[i] = std::max(result[node(fanin0[i])], result[node(fanin1[i])]) + 1;
+	return result;
+}
+
+int AigGraph::depth() const
+{
+	std::vector<int> node_levels = levels();
+	int result = 0;
+	for (auto lit : outputs)
+		result = std::max(result, node_levels[node(lit)]);
+	return result;
+}
+
+void AigGraph::simulate(std::vector<uint64_t> &values, int words) const
+{
+	log_assert(GetSize(values) == size() * words);
+	for (int k = 0; k < words; k++)
+		values[k] = 0;
+	for (int i = 0; i < size(); i++) {
+		if (!is_and(i))
+			continue;
+		uint64_t mask0 = is_compl(fanin0[i]) ? ~uint64_t(0) : 0;
+		uint64_t mask1 = is_compl(fanin1[i]) ? ~uint64_t(0) : 0;
+		const uint64_t *in0 = &values[node(fanin0[i]) * words];
+		const uint64_t *in1 = &values[node(fanin1[i]) * words];
+		uint64_t *out = &values[i * words];
+		for (int k = 0; k < words; k++)
+			out[k] = (in0[k] ^ mask0) & (in1[k] ^ mask1);
+	}
+}
+
+AigGraph AigGraph::cleanup() const
+{
+	std::vector<bool> live(size());
+	for (auto lit : outputs)
+		live[node(lit)] = true;
+	for (int i = size() - 1; i > 0; i--)
+		if (live[i] && is_and(i)) {
+			live[node(fanin0[i])] = true;
+			live[node(fanin1[i])] = true;
+		}
+
+	AigGraph result;
+	std::vector<Lit> map(size(), LIT_NONE);
+	map[0] = LIT_FALSE;
+	for (int i = 1; i < size(); i++) {
+		if (!is_and(i))
+			map[i] = result.add_input();
+		else if (live[i])
+			map[i] = result.add_and(lit_not_cond(map[node(fanin0[i])], is_compl(fanin0[i])),
+					lit_not_cond(map[node(fanin1[i])], is_compl(fanin1[i])));
+	}
+	for (auto lit : outputs)
+		result.add_output(lit_not_cond(map[node(lit)], is_compl(lit)));
+	return result;
+}
+
+YOSYS_NAMESPACE_END
@@ -0,0 +1,101 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef AIGGRAPH_H
+#define AIGGRAPH_H
+
+#include "kernel/yosys.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+// A structurally hashed and-inverter graph. Node 0 is the constant false node,
+// all other nodes are primary inputs or two-input AND nodes. Nodes are kept in
+// contiguous arrays and are always created after their fanins, so the node
+// index order is a topological order.
+//
+// Edges are 32-bit literals: twice the node index, plus one if the edge is
+// complemented.
+struct AigGraph
+{
+	typedef uint32_t Lit;
+
+	static const Lit LIT_FALSE = 0;
+	static const Lit LIT_TRUE = 1;
+	static const Lit LIT_NONE = 0xffffffff;
+
+	// Fanin literals of AND nodes, LIT_NONE for the constant and the inputs.
+	std::vector<Lit> fanin0, fanin1;
+	std::vector<int> inputs;
+	std::vector<Lit> outputs;
+	dict<int64_t, int> strash;
+
+	AigGraph();
+
+	static int node(Lit lit) { return lit >> 1; }
+	static bool is_compl(Lit lit) { return lit & 1; }
+	static Lit make_lit(int node, bool inv = false) { return Lit(node) << 1 | Lit(inv); }
+	static Lit lit_not(Lit lit) { return lit ^ 1; }
+	static Lit lit_not_cond(Lit lit, bool inv) { return lit ^ Lit(inv); }
+	static Lit lit_regular(Lit lit) { return lit & ~Lit(1); }
+
+	int size() const { return GetSize(fanin0); }
+	int num_inputs() const { return GetSize(inputs); }
+	int num_ands() const { return size() - 1 - num_inputs(); }
+	bool is_and(int n) const { return fanin0[n] != LIT_NONE; }
+	bool is_input(int n) const { return n != 0 && fanin0[n] == LIT_NONE; }
+
+	Lit add_input();
+	int add_output(Lit lit);
+
+	// Returns the literal of `a & b', creating a new node only if the
+	// function is not trivial and no structurally identical node exists.
+	Lit add_and(Lit a, Lit b);
+	Lit add_or(Lit a, Lit b) { return lit_not(add_and(lit_not(a), lit_not(b))); }
+	Lit add_xor(Lit a, Lit b);
+	Lit add_mux(Lit a, Lit b, Lit s);
+
+	// Like add_and(), but never creates a node. Returns LIT_NONE if
+	// add_and() would have to create one.
+	Lit lookup_and(Lit a, Lit b) const;
+
+	// Handles the constant and idempotent cases of `a & b' and normalizes the
+	// fanin order. Returns the result if it is trivial, LIT_NONE otherwise.
+	static Lit trivial_and(Lit &a, Lit &b);
+
+	// Removes all nodes with index `n' or larger. The outputs must not
+	// refer to any of them.
+	void rollback(int n);
+
+	// Number of AND fanouts and outputs that refer to each node.
+	std::vector<int> fanout_counts() const;
+	std::vector<int> levels() const;
+	int depth() const;
+
+	// Computes the values of the AND nodes from the values of the
+	// inputs, `words' 64-bit words per node.
+	void simulate(std::vector<uint64_t> &values, int words) const;
+
+	// Returns a copy with the same inputs and outputs that only has the
+	// AND nodes reachable from the outputs.
+	AigGraph cleanup() const;
+};
+
+YOSYS_NAMESPACE_END
+
+#endif
@@ -393,6 +393,366 @@ struct ConstEval
 	}
 };
 
+// Evaluates the same combinational cone for many input assignments at once, using bit-sliced evaluation: every
+// signal bit is represented by two 64-bit words holding its value and its definedness in 64 assignments (lanes).
+// After compile() has translated the cone into a flat list of steps, every batch of 64 assignments is evaluated
+// without any per-bit hashing. Undefined values are propagated like in ConstEval. Cells that have no bit-sliced
+// implementation are evaluated one lane at a time using CellTypes::eval(), with the same inputs ConstEval passes.
+struct ConstEvalVec
+{
+	static const int lanes = 64;
+
+	enum op_t {
+		OP_BUF, OP_NOT, OP_AND, OP_NAND, OP_OR, OP_NOR, OP_XOR, OP_XNOR, OP_ANDNOT, OP_ORNOT,
+		OP_MUX, OP_NMUX, OP_GENERIC
+	};
+
+	struct step_t {
+		RTLIL::Cell *cell;
+		op_t op;
+		std::vector<int> a, b, c, d, s, y;
+	};
+
+	RTLIL::Module *module;
+	SigMap assign_map;
+	dict<RTLIL::SigBit, RTLIL::Cell*> bit2driver;
+	dict<RTLIL::SigBit, RTLIL::State> const_bits;
+
+	dict<RTLIL::SigBit, int> bit_index;
+	pool<RTLIL::Cell*> busy;
+	std::vector<step_t> program;
+	std::vector<int> input_index, output_index;
+	std::vector<uint64_t> val, def;
+
+	ConstEvalVec(RTLIL::Module *module) : module(module), assign_map(module)
+	{
+		CellTypes ct;
+		ct.setup_internals();
+		ct.setup_stdcells();
+
+		for (auto cell : module->cells()) {
+			if (!ct.cell_known(cell->type))
+				continue;
+			for (auto &conn : cell->connections())
+				if (ct.cell_output(cell->type, conn.first))
+					for (auto bit : assign_map(conn.second))
+						if (bit.wire != nullptr && !bit2driver.count(bit))
+							bit2driver[bit] = cell;
+		}
+	}
+
+	// Sets `sig` to `value` in all lanes. Must be called before compile().
+	void set(RTLIL::SigSpec sig, const RTLIL::Const &value)
+	{
+		assign_map.apply(sig);
+		for (int i = 0; i < GetSize(sig); i++)
+			if (sig[i].wire != nullptr)
+				const_bits[sig[i]] = value.bits.at(i);
+	}
+
+	int new_index()
+	{
+		val.push_back(0);
+		def.push_back(0);
+		return GetSize(val) - 1;
+	}
+
+	int const_index(RTLIL::State state)
+	{
+		if (state == RTLIL::State::S0)
+			return 0;
+		if (state == RTLIL::State::S1)
+			return 1;
+		return 2;
+	}
+
+	bool visit(RTLIL::SigBit bit, int &index, RTLIL::SigSpec &undef)
+	{
+		if (bit.wire == nullptr) {
+			index = const_index(bit.data);
+			return true;
+		}
+
+		auto it = bit_index.find(bit);
+		if (it != bit_index.end()) {
+			index = it->second;
+			return true;
+		}
+
+		auto driver_it = bit2driver.find(bit);
+		if (driver_it == bit2driver.end()) {
+			undef.append(bit);
+			index = bit_index[bit] = new_index();
+			return true;
+		}
+
+		if (!visit(driver_it->second, undef))
+			return false;
+		index = bit_index.at(bit);
+		return true;
+	}
+
+	bool visit(RTLIL::SigSpec sig, std::vector<int> &indices, RTLIL::SigSpec &undef)
+	{
+		indices.clear();
+		for (auto bit : assign_map(sig)) {
+			int index;
+			if (!visit(bit, index, undef))
+				return false;
+			indices.push_back(index);
+		}
+		return true;
+	}
+
+	void extend(std::vector<int> &indices, int width, bool is_signed)
+	{
+		int fill = is_signed && !indices.empty() ? indices.back() : 0;
+		indices.resize(width, fill);
+	}
+
+	bool visit(RTLIL::Cell *cell, RTLIL::SigSpec &undef)
+	{
+		if (busy.count(cell))
+			return false;
+		if (cell->type.in(ID($lcu), ID($fa), ID($alu), ID($macc)) || !yosys_celltypes.cell_evaluable(cell->type))
+			return false;
+
+		// Cells with other inputs, like the T and U selects of $_MUX4_, are left to ConstEval.
+		bool is_mux = cell->type.in(ID($mux), ID($pmux), ID($_MUX_), ID($_NMUX_));
+		bool is_aoi = cell->type.in(ID($_AOI3_), ID($_OAI3_), ID($_AOI4_), ID($_OAI4_));
+		for (auto &conn : cell->connections())
+			if (!conn.first.in(ID::A, ID::B, ID::Y) && !(is_mux && conn.first == ID::S) && !(is_aoi && conn.first.in(ID::C, ID::D)))
+				return false;
+		busy.insert(cell);
+
+		step_t step;
+		step.cell = cell;
+		step.op = OP_GENERIC;
+		if (cell->hasPort(ID::A) && !visit(cell->getPort(ID::A), step.a, undef))
+			return false;
+		if (cell->hasPort(ID::B) && !visit(cell->getPort(ID::B), step.b, undef))
+			return false;
+		if (cell->hasPort(ID::C) && !visit(cell->getPort(ID::C), step.c, undef))
+			return false;
+		if (cell->hasPort(ID::S) && !visit(cell->getPort(ID::S), step.s, undef))
+			return false;
+		if (cell->hasPort(ID::D) && !visit(cell->getPort(ID::D), step.d, undef))
+			return false;
+
+		int width = GetSize(cell->getPort(ID::Y));
+		bool is_signed = cell->hasParam(ID::A_SIGNED) && cell->getParam(ID::A_SIGNED).as_bool();
+		if (cell->hasParam(ID::B_SIGNED) && !cell->getParam(ID::B_SIGNED).as_bool())
+			is_signed = false;
+
+		static const dict<RTLIL::IdString, op_t> gate_ops = {
+			{ID($_BUF_), OP_BUF}, {ID($_NOT_), OP_NOT}, {ID($_AND_), OP_AND}, {ID($_NAND_), OP_NAND},
+			{ID($_OR_), OP_OR}, {ID($_NOR_), OP_NOR}, {ID($_XOR_), OP_XOR}, {ID($_XNOR_), OP_XNOR},
+			{ID($_ANDNOT_), OP_ANDNOT}, {ID($_ORNOT_), OP_ORNOT}, {ID($_MUX_), OP_MUX}, {ID($_NMUX_), OP_NMUX},
+			{ID($mux), OP_MUX}, {ID($pmux), OP_MUX},
+		};
+		static const dict<RTLIL::IdString, op_t> word_ops = {
+			{ID($pos), OP_BUF}, {ID($not), OP_NOT}, {ID($and), OP_AND}, {ID($or), OP_OR},
+			{ID($xor), OP_XOR}, {ID($xnor), OP_XNOR},
+		};
+
+		auto gate_it = gate_ops.find(cell->type);
+		auto word_it = word_ops.find(cell->type);
+		if (gate_it != gate_ops.end()) {
+			step.op = gate_it->second;
+		} else if (word_it != word_ops.end()) {
+			step.op = word_it->second;
+			extend(step.a, width, is_signed);
+			if (step.op != OP_BUF && step.op != OP_NOT)
+				extend(step.b, width, is_signed);
+		}
+
+		// Outputs that are constant, or overridden by a set() value or an input, go to a scratch index.
+		for (auto bit : assign_map(cell->getPort(ID::Y))) {
+			if (bit.wire != nullptr && !bit_index.count(bit))
+				step.y.push_back(bit_index[bit] = new_index());
+			else
+				step.y.push_back(new_index());
+		}
+		program.push_back(step);
+		return true;
+	}
+
+	// Prepares the evaluation of `outputs` as a function of `inputs`. Returns false if the cone of `outputs`
+	// contains a combinational loop or a cell that can only be evaluated with ConstEval. The bits that are neither
+	// inputs, nor set to a constant, nor driven by a cell are added to `undef`; they are always evaluated as x.
+	bool compile(const RTLIL::SigSpec &inputs, const RTLIL::SigSpec &outputs, RTLIL::SigSpec &undef)
+	{
+		bit_index.clear();
+		busy.clear();
+		program.clear();
+		input_index.clear();
+		output_index.clear();
+		val = { 0, ~uint64_t(0), 0 };
+		def = { ~uint64_t(0), ~uint64_t(0), 0 };
+
+		for (auto &it : const_bits)
+			bit_index[it.first] = const_index(it.second);
+
+		for (auto bit : assign_map(inputs)) {
+			log_assert(bit.wire != nullptr);
+			auto it = bit_index.find(bit);
+			input_index.push_back(it != bit_index.end() && it->second > 2 ? it->second : (bit_index[bit] = new_index()));
+		}
+
+		for (auto bit : assign_map(outputs)) {
+			int index;
+			if (!visit(bit, index, undef))
+				return false;
+			output_index.push_back(index);
+		}
+		return true;
+	}
+
+	// Sets the value of the inputs in the given lane.
+	void set_input(int lane, const RTLIL::Const &value)
+	{
+		uint64_t mask = uint64_t(1) << lane;
+		for (int i = 0; i < GetSize(input_index); i++) {
+			int index = input_index[i];
+			RTLIL::State state = value.bits.at(i);
+			if (state == RTLIL::State::S1)
+				val[index] |= mask;
+			else
+				val[index] &= ~mask;
+			if (state == RTLIL::State::S0 || state == RTLIL::State::S1)
+				def[index] |= mask;
+			else
+				def[index] &= ~mask;
+		}
+	}
+
+	RTLIL::Const get_output(int lane) const
+	{
+		return get_lane(output_index, lane);
+	}
+
+	// Evaluates the compiled cone in the first `num_lanes` lanes. Returns false if CellTypes::eval() failed for
+	// a cell, like ConstEval does.
+	bool run(int num_lanes = lanes)
+	{
+		for (auto &step : program)
+		{
+			const std::vector<int> &a = step.a, &b = step.b, &s = step.s, &y = step.y;
+			switch (step.op)
+			{
+			case OP_BUF:
+			case OP_NOT:
+				for (int i = 0; i < GetSize(y); i++) {
+					uint64_t d = def[a[i]];
+					val[y[i]] = step.op == OP_NOT ? ~val[a[i]] & d : val[a[i]];
+					def[y[i]] = d;
+				}
+				break;
+			case OP_AND:
+			case OP_NAND:
+			case OP_ANDNOT:
+				for (int i = 0; i < GetSize(y); i++) {
+					uint64_t va = val[a[i]], da = def[a[i]], vb = val[b[i]], db = def[b[i]];
+					if (step.op == OP_ANDNOT)
+						vb = ~vb & db;
+					uint64_t v = va & vb, d = (da & db) | (da & ~va) | (db & ~vb);
+					val[y[i]] = step.op == OP_NAND ? ~v & d : v;
+					def[y[i]] = d;
+				}
+				break;
+			case OP_OR:
+			case OP_NOR:
+			case OP_ORNOT:
+				for (int i = 0; i < GetSize(y); i++) {
+					uint64_t va = val[a[i]], da = def[a[i]], vb = val[b[i]], db = def[b[i]];
+					if (step.op == OP_ORNOT)
+						vb = ~vb & db;
+					uint64_t v = va | vb, d = (da & db) | va | vb;
+					val[y[i]] = step.op == OP_NOR ? ~v & d : v;
+					def[y[i]] = d;
+				}
+				break;
+			case OP_XOR:
+			case OP_XNOR:
+				for (int i = 0; i < GetSize(y); i++) {
+					uint64_t d = def[a[i]] & def[b[i]];
+					uint64_t v = (val[a[i]] ^ val[b[i]]) & d;
+					val[y[i]] = step.op == OP_XNOR ? ~v & d : v;
+					def[y[i]] = d;
+				}
+				break;
+			case OP_MUX:
+			case OP_NMUX: {
+				// Like ConstEval, every input selected by a bit of S that is 1 or x is a candidate, and so is A
+				// if no bit of S is 1. The result is defined where all candidates are defined and equal.
+				uint64_t any_set = 0;
+				for (int index : s)
+					any_set |= val[index] & def[index];
+				for (int i = 0; i < GetSize(y); i++) {
+					uint64_t all_ones = any_set | val[a[i]];
+					uint64_t all_zeros = any_set | (def[a[i]] & ~val[a[i]]);
+					for (int j = 0; j < GetSize(s); j++) {
+						uint64_t candidate = val[s[j]] | ~def[s[j]];
+						int index = b[j * GetSize(y) + i];
+						all_ones &= ~candidate | val[index];
+						all_zeros &= ~candidate | (def[index] & ~val[index]);
+					}
+					val[y[i]] = step.op == OP_NMUX ? all_zeros : all_ones;
+					def[y[i]] = all_ones | all_zeros;
+				}
+				break;
+			}
+			case OP_GENERIC:
+				for (int lane = 0; lane < num_lanes; lane++) {
+					RTLIL::Const arg_a = get_lane(step.a, lane), arg_b = get_lane(step.b, lane);
+					RTLIL::Const arg_c = get_lane(step.c, lane), arg_d = get_lane(step.d, lane);
+					bool eval_err = false;
+					RTLIL::Const result = CellTypes::eval(step.cell, arg_a, arg_b, arg_c, arg_d, &eval_err);
+					if (eval_err)
+						return false;
+					uint64_t mask = uint64_t(1) << lane;
+					for (int i = 0; i < GetSize(y); i++) {
+						RTLIL::State state = i >= GetSize(result) ? RTLIL::State::Sx : result.bits[i];
+						val[y[i]] = state == RTLIL::State::S1 ? val[y[i]] | mask : val[y[i]] & ~mask;
+						def[y[i]] = state == RTLIL::State::S0 || state == RTLIL::State::S1 ? def[y[i]] | mask : def[y[i]] & ~mask;
+					}
+				}
+				break;
+			}
+		}
+		return true;
+	}
+
+	RTLIL::Const get_lane(const std::vector<int> &indices, int lane) const
+	{
+		uint64_t mask = uint64_t(1) << lane;
+		RTLIL::Const value;
+		value.bits.reserve(indices.size());
+		for (int index : indices)
+			value.bits.push_back(!(def[index] & mask) ? RTLIL::State::Sx :
+					(val[index] & mask) ? RTLIL::State::S1 : RTLIL::State::S0);
+		return value;
+	}
+
+	// Evaluates the compiled cone for all `input_values`, in batches of 64, and stores the output values in the
+	// same order. Returns false if the evaluation of a cell failed.
+	bool eval(const std::vector<RTLIL::Const> &input_values, std::vector<RTLIL::Const> &output_values)
+	{
+		output_values.clear();
+		output_values.reserve(input_values.size());
+		for (int offset = 0; offset < GetSize(input_values); offset += lanes) {
+			int num_lanes = std::min(lanes, GetSize(input_values) - offset);
+			for (int lane = 0; lane < num_lanes; lane++)
+				set_input(lane, input_values[offset + lane]);
+			if (!run(num_lanes))
+				return false;
+			for (int lane = 0; lane < num_lanes; lane++)
+				output_values.push_back(get_output(lane));
+		}
+		return true;
+	}
+};
+
 YOSYS_NAMESPACE_END
 
 #endif
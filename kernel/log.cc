@@ -50,6 +50,7 @@ bool log_expect_no_warnings = false;
 bool log_hdump_all = false;
 FILE *log_errfile = NULL;
 SHA1 *log_hasher = NULL;
+std::vector<std::pair<std::string, std::string>> *log_warnings_capture = NULL;
 
 bool log_time = false;
 bool log_error_stderr = false;
@@ -237,6 +238,9 @@ static void logv_warning_with_prefix(const char *prefix,
 	std::string message = vstringf(format, ap);
 	bool suppressed = false;
 
+	if (log_warnings_capture)
+		log_warnings_capture->push_back(std::make_pair(std::string(prefix), message));
+
 	for (auto &re : log_nowarn_regexes)
 		if (YS_REGEX_NS::regex_search(message, re))
 			suppressed = true;
@@ -297,6 +301,19 @@ void logv_warning_noprefix(const char *format, va_list ap)
 	logv_warning_with_prefix("", format, ap);
 }
 
+static void log_warning_with_prefix(const char *prefix, const char *format, ...)
+{
+	va_list ap;
+	va_start(ap, format);
+	logv_warning_with_prefix(prefix, format, ap);
+	va_end(ap);
+}
+
+void log_replay_warning(const std::string &prefix, const std::string &message)
+{
+	log_warning_with_prefix(prefix.c_str(), "%s", message.c_str());
+}
+
 void log_file_warning(const std::string &filename, int lineno,
                       const char *format, ...)
 {
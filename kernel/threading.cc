@@ -0,0 +1,62 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "kernel/threading.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+int ThreadPool::pool_size(int reserved_cores, int max_threads)
+{
+#ifdef YOSYS_ENABLE_THREADS
+	int num_threads = std::thread::hardware_concurrency() - reserved_cores;
+	// Allows testing the threaded code paths on machines with few cores.
+	const char *env_force_threads = getenv("YOSYS_FORCE_THREADS");
+	if (env_force_threads != nullptr)
+		num_threads = atoi(env_force_threads);
+	const char *env_max_threads = getenv("YOSYS_MAX_THREADS");
+	if (env_max_threads != nullptr)
+		max_threads = std::min(max_threads, atoi(env_max_threads));
+	return std::max(0, std::min(num_threads, max_threads));
+#else
+	(void)reserved_cores, (void)max_threads;
+	return 0;
+#endif
+}
+
+ThreadPool::ThreadPool(int pool_size, std::function<void(int)> body)
+{
+#ifdef YOSYS_ENABLE_THREADS
+	threads.reserve(pool_size);
+	for (int i = 0; i < pool_size; i++)
+		threads.emplace_back(body, i);
+#else
+	log_assert(pool_size == 0);
+	(void)body;
+#endif
+}
+
+ThreadPool::~ThreadPool()
+{
+#ifdef YOSYS_ENABLE_THREADS
+	for (auto &thread : threads)
+		thread.join();
+#endif
+}
+
+YOSYS_NAMESPACE_END
@@ -0,0 +1,125 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef THREADING_H
+#define THREADING_H
+
+#include "kernel/yosys.h"
+
+#include <deque>
+#include <functional>
+
+#ifdef YOSYS_ENABLE_THREADS
+#  include <thread>
+#  include <mutex>
+#  include <condition_variable>
+#endif
+
+YOSYS_NAMESPACE_BEGIN
+
+// Most of the Yosys kernel is not thread safe. In particular, worker threads must not create, copy or destroy
+// IdStrings (this includes copying cells' connection or parameter dicts), must not modify the design, and must
+// not call any of the log functions. Worker threads should operate on plain data prepared by the main thread
+// and hand their results back to the main thread.
+
+// A FIFO queue for handing items from producer threads to consumer threads.
+template<typename T>
+class ConcurrentQueue
+{
+public:
+	void push_back(T &&item)
+	{
+	#ifdef YOSYS_ENABLE_THREADS
+		std::unique_lock<std::mutex> lock(mutex);
+	#endif
+		contents.push_back(std::move(item));
+	#ifdef YOSYS_ENABLE_THREADS
+		lock.unlock();
+		not_empty.notify_one();
+	#endif
+	}
+
+	// Blocks until an item is available. Returns false if the queue is closed and empty.
+	bool pop_front(T &item)
+	{
+	#ifdef YOSYS_ENABLE_THREADS
+		std::unique_lock<std::mutex> lock(mutex);
+		not_empty.wait(lock, [this] { return closed || !contents.empty(); });
+	#endif
+		if (contents.empty())
+			return false;
+		item = std::move(contents.front());
+		contents.pop_front();
+		return true;
+	}
+
+	// Wakes up all consumers waiting for items; no items may be pushed afterwards.
+	void close()
+	{
+	#ifdef YOSYS_ENABLE_THREADS
+		std::unique_lock<std::mutex> lock(mutex);
+	#endif
+		closed = true;
+	#ifdef YOSYS_ENABLE_THREADS
+		lock.unlock();
+		not_empty.notify_all();
+	#endif
+	}
+
+private:
+#ifdef YOSYS_ENABLE_THREADS
+	std::mutex mutex;
+	std::condition_variable not_empty;
+#endif
+	std::deque<T> contents;
+	bool closed = false;
+};
+
+// A set of worker threads, all running the same function (which receives the index of the thread). The
+// destructor waits for all threads to finish.
+class ThreadPool
+{
+public:
+	// Number of worker threads to use, given that `reserved_cores` cores stay busy with other work (usually
+	// the main thread), capped by `max_threads` and the YOSYS_MAX_THREADS environment variable. The number of
+	// available cores can be overridden with the YOSYS_FORCE_THREADS environment variable. Returns 0 if
+	// threads are not available; the caller must then do all the work itself.
+	static int pool_size(int reserved_cores, int max_threads);
+
+	ThreadPool(int pool_size, std::function<void(int)> body);
+	~ThreadPool();
+
+	int num_threads() const
+	{
+	#ifdef YOSYS_ENABLE_THREADS
+		return GetSize(threads);
+	#else
+		return 0;
+	#endif
+	}
+
+private:
+#ifdef YOSYS_ENABLE_THREADS
+	std::vector<std::thread> threads;
+#endif
+};
+
+YOSYS_NAMESPACE_END
+
+#endif
@@ -295,8 +295,25 @@ class SubCircuit::SolverWorker
 		Graph graph;
 		adjMatrix_t adjMatrix;
 		std::vector<bool> usedNodes;
+		// signature used to rule out matches early: the nodes of each
+		// type and the number of incoming edges of each node in adjMatrix
+		std::map<std::string, std::vector<int>> nodesByTypeId;
+		std::vector<int> inDegree;
 	};
 
+	static void updateSignature(GraphData &gd)
+	{
+		gd.nodesByTypeId.clear();
+		for (int i = 0; i < int(gd.graph.nodes.size()); i++)
+			gd.nodesByTypeId[gd.graph.nodes[i].typeId].push_back(i);
+
+		gd.inDegree.clear();
+		gd.inDegree.resize(gd.graph.nodes.size());
+		for (const auto &row : gd.adjMatrix)
+			for (const auto &it : row)
+				gd.inDegree[it.first]++;
+	}
+
 	static void printAdjMatrix(const adjMatrix_t &matrix)
 	{
 		my_printf("%7s", "");
@@ -846,34 +863,71 @@ class SubCircuit::SolverWorker
 		return false;
 	}
 
-	void generateEnumerationMatrix(std::vector<std::set<int>> &enumerationMatrix, const GraphData &needle, const GraphData &haystack, const std::map<std::string, std::set<std::string>> &initialMappings) const
+	static const std::vector<int> &nodesOfType(const GraphData &gd, const std::string &typeId)
 	{
-		std::map<std::string, std::set<int>> haystackNodesByTypeId;
-		for (int i = 0; i < int(haystack.graph.nodes.size()); i++)
-			haystackNodesByTypeId[haystack.graph.nodes[i].typeId].insert(i);
+		static const std::vector<int> noNodes;
+		auto it = gd.nodesByTypeId.find(typeId);
+		return it != gd.nodesByTypeId.end() ? it->second : noNodes;
+	}
+
+	bool checkSignature(const GraphData &needle, const GraphData &haystack) const
+	{
+		// every needle node needs its own haystack node of the same or a compatible type
+		for (const auto &it : needle.nodesByTypeId)
+		{
+			std::set<std::string> types = { it.first };
+			if (compatibleTypes.count(it.first) > 0)
+				types.insert(compatibleTypes.at(it.first).begin(), compatibleTypes.at(it.first).end());
+
+			int available = 0;
+			for (const auto &type : types)
+				available += nodesOfType(haystack, type).size();
+
+			if (available < int(it.second.size())) {
+				if (verbose)
+					my_printf("Haystack %s has only %d of the %d nodes of type %s needed by needle %s.\n",
+							haystack.graphId.c_str(), available, int(it.second.size()), it.first.c_str(), needle.graphId.c_str());
+				return false;
+			}
+		}
 
+		return true;
+	}
+
+	bool matchDegrees(const GraphData &needle, int needleNodeIdx, const GraphData &haystack, int haystackNodeIdx) const
+	{
+		// the edges of a needle node must be mapped to distinct edges of the haystack node
+		return needle.adjMatrix[needleNodeIdx].size() <= haystack.adjMatrix[haystackNodeIdx].size() &&
+				needle.inDegree[needleNodeIdx] <= haystack.inDegree[haystackNodeIdx];
+	}
+
+	void generateEnumerationMatrix(std::vector<std::set<int>> &enumerationMatrix, const GraphData &needle, const GraphData &haystack, const std::map<std::string, std::set<std::string>> &initialMappings) const
+	{
 		enumerationMatrix.clear();
 		enumerationMatrix.resize(needle.graph.nodes.size());
+		if (!checkSignature(needle, haystack))
+			return;
+
 		for (int i = 0; i < int(needle.graph.nodes.size()); i++)
 		{
 			const Graph::Node &nn = needle.graph.nodes[i];
 
-			for (int j : haystackNodesByTypeId[nn.typeId]) {
+			for (int j : nodesOfType(haystack, nn.typeId)) {
 				const Graph::Node &hn = haystack.graph.nodes[j];
 				if (initialMappings.count(nn.nodeId) > 0 && initialMappings.at(nn.nodeId).count(hn.nodeId) == 0)
 					continue;
-				if (!matchNodes(needle, i, haystack, j))
+				if (!matchDegrees(needle, i, haystack, j) || !matchNodes(needle, i, haystack, j))
 					continue;
 				enumerationMatrix[i].insert(j);
 			}
 
 			if (compatibleTypes.count(nn.typeId) > 0)
 				for (const std::string &compatibleTypeId : compatibleTypes.at(nn.typeId))
-					for (int j : haystackNodesByTypeId[compatibleTypeId]) {
+					for (int j : nodesOfType(haystack, compatibleTypeId)) {
 						const Graph::Node &hn = haystack.graph.nodes[j];
 						if (initialMappings.count(nn.nodeId) > 0 && initialMappings.at(nn.nodeId).count(hn.nodeId) == 0)
 							continue;
-						if (!matchNodes(needle, i, haystack, j))
+						if (!matchDegrees(needle, i, haystack, j) || !matchNodes(needle, i, haystack, j))
 							continue;
 						enumerationMatrix[i].insert(j);
 					}
@@ -1290,6 +1344,7 @@ class SubCircuit::SolverWorker
 		needle.graph = Graph(graph, needle_nodes);
 		needle.graph.markAllExtern();
 		diCache.add(needle.graph, needle.adjMatrix, graphId, userSolver);
+		updateSignature(needle);
 
 		std::vector<Solver::Result> ullmannResults;
 		solveForMining(ullmannResults, needle);
@@ -1486,6 +1541,7 @@ protected:
 		gd.graphId = graphId;
 		gd.graph = graph;
 		diCache.add(gd.graph, gd.adjMatrix, graphId, userSolver);
+		updateSignature(gd);
 	}
 
 	void addCompatibleTypes(std::string needleTypeId, std::string haystackTypeId)
@@ -42,7 +42,7 @@ struct DesignPass : public Pass {
 		log("\n");
 		log("    design -reset\n");
 		log("\n");
-		log("Clear the current design.\n");
+		log("Clear the current design and the cache of derived parametric modules.\n");
 		log("\n");
 		log("\n");
 		log("    design -save <name>\n");
@@ -109,6 +109,7 @@ struct DesignPass : public Pass {
 	{
 		bool got_mode = false;
 		bool reset_mode = false;
+		bool reset_cache_mode = false;
 		bool reset_vlog_mode = false;
 		bool push_mode = false;
 		bool push_copy_mode = false;
@@ -125,6 +126,7 @@ struct DesignPass : public Pass {
 			if (!got_mode && args[argidx] == "-reset") {
 				got_mode = true;
 				reset_mode = true;
+				reset_cache_mode = true;
 				continue;
 			}
 			if (!got_mode && args[argidx] == "-reset-vlog") {
@@ -381,6 +383,9 @@ struct DesignPass : public Pass {
 			design->verilog_defines->clear();
 		}
 
+		if (reset_cache_mode || reset_vlog_mode || !load_name.empty())
+			AST::clear_derive_cache();
+
 		if (!load_name.empty() || pop_mode)
 		{
 			RTLIL::Design *saved_design = pop_mode ? pushed_designs.back() : saved_designs.at(load_name);
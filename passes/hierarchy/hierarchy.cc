@@ -864,6 +864,10 @@ struct HierarchyPass : public Pass {
 					mod->attributes.erase(ID::initial_top);
 		}
 
+		// Modules for which expand_module() had nothing left to do. Their cells are all resolved, and nothing done
+		// while expanding other modules can change that, so they are not expanded again in later iterations.
+		pool<RTLIL::Module*> expanded_modules;
+
 		bool did_something = true;
 		while (did_something)
 		{
@@ -879,8 +883,12 @@ struct HierarchyPass : public Pass {
 			}
 
 			for (auto module : used_modules) {
+				if (expanded_modules.count(module))
+					continue;
 				if (expand_module(design, module, flag_check, flag_simcheck, libdirs))
 					did_something = true;
+				else
+					expanded_modules.insert(module);
 			}
 
 
@@ -901,6 +909,7 @@ struct HierarchyPass : public Pass {
 				}
 			}
 			for(size_t i=0; i<modules_to_delete.size(); i++) {
+				expanded_modules.erase(modules_to_delete[i]);
 				design->remove(modules_to_delete[i]);
 			}
 		}
@@ -0,0 +1,897 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+// [[CITE]] DAG-aware AIG rewriting
+// Alan Mishchenko, Satrajit Chatterjee, Robert Brayton, "DAG-Aware AIG Rewriting: A Fresh Look at
+// Combinational Logic Synthesis," Proc. DAC 2006, pp. 532-535.
+// doi: 10.1145/1146909.1147048
+
+// [[CITE]] FRAIGs
+// Alan Mishchenko, Satrajit Chatterjee, Roland Jiang, Robert Brayton, "FRAIGs: A Unifying Representation
+// for Logic Synthesis and Verification," ERL Technical Report, EECS Dept., UC Berkeley, March 2005.
+
+#include "kernel/yosys.h"
+#include "kernel/sigtools.h"
+#include "kernel/satgen.h"
+#include "kernel/aiggraph.h"
+#include <queue>
+
+USING_YOSYS_NAMESPACE
+PRIVATE_NAMESPACE_BEGIN
+
+typedef AigGraph::Lit Lit;
+
+// Moves the selected $_AND_ and $_NOT_ gates of a module into an AigGraph,
+// and replaces them with the gates of an optimized graph.
+struct AigModuleWorker
+{
+	RTLIL::Module *module;
+	SigMap sigmap;
+	AigGraph aig;
+	// The signal of each graph input, and the gate output bit each graph
+	// output has to drive.
+	std::vector<RTLIL::SigBit> input_bits, output_bits;
+	std::vector<RTLIL::Cell*> gates;
+	int and_gates = 0;
+	dict<RTLIL::SigBit, RTLIL::Cell*> drivers;
+	dict<RTLIL::SigBit, Lit> bit_lits;
+
+	AigModuleWorker(RTLIL::Module *module) : module(module), sigmap(module)
+	{
+		pool<RTLIL::Cell*> other_cells;
+		for (auto cell : module->cells()) {
+			if (!module->design->selected(module, cell) || !cell->type.in(ID($_AND_), ID($_NOT_)) || cell->get_bool_attribute(ID::keep)) {
+				other_cells.insert(cell);
+				continue;
+			}
+			RTLIL::SigBit bit = sigmap(cell->getPort(ID::Y)[0]);
+			if (bit.wire == nullptr || drivers.count(bit)) {
+				other_cells.insert(cell);
+				continue;
+			}
+			drivers[bit] = cell;
+			gates.push_back(cell);
+			if (cell->type == ID($_AND_))
+				and_gates++;
+		}
+
+		pool<RTLIL::SigBit> outputs;
+		for (auto cell : other_cells)
+			for (auto &conn : cell->connections())
+				for (auto bit : sigmap(conn.second))
+					if (drivers.count(bit))
+						outputs.insert(bit);
+		for (auto wire : module->wires())
+			if (wire->port_output || wire->get_bool_attribute(ID::keep))
+				for (auto bit : sigmap(wire))
+					if (drivers.count(bit))
+						outputs.insert(bit);
+		for (auto &conn : module->connections())
+			for (auto bit : sigmap(conn.second))
+				if (drivers.count(bit))
+					outputs.insert(bit);
+
+		for (auto bit : outputs) {
+			aig.add_output(import_bit(bit));
+			output_bits.push_back(drivers.at(bit)->getPort(ID::Y)[0]);
+		}
+	}
+
+	Lit import_bit(RTLIL::SigBit root)
+	{
+		pool<RTLIL::SigBit> visiting;
+		std::vector<RTLIL::SigBit> stack = {root};
+		while (!stack.empty()) {
+			RTLIL::SigBit bit = stack.back();
+			if (bit_lits.count(bit)) {
+				stack.pop_back();
+				continue;
+			}
+
+			auto it = drivers.find(bit);
+			if (it == drivers.end()) {
+				if (bit == State::S0)
+					bit_lits[bit] = AigGraph::LIT_FALSE;
+				else if (bit == State::S1)
+					bit_lits[bit] = AigGraph::LIT_TRUE;
+				else {
+					bit_lits[bit] = aig.add_input();
+					input_bits.push_back(bit);
+				}
+				stack.pop_back();
+				continue;
+			}
+
+			RTLIL::Cell *cell = it->second;
+			std::vector<RTLIL::SigBit> fanins = {sigmap(cell->getPort(ID::A)[0])};
+			if (cell->type == ID($_AND_))
+				fanins.push_back(sigmap(cell->getPort(ID::B)[0]));
+
+			bool ready = true;
+			for (auto fanin : fanins) {
+				if (bit_lits.count(fanin))
+					continue;
+				if (visiting.count(fanin))
+					log_error("Found combinational loop through %s in module %s.\n", log_signal(fanin), log_id(module));
+				stack.push_back(fanin);
+				ready = false;
+			}
+			if (!ready) {
+				visiting.insert(bit);
+				continue;
+			}
+
+			visiting.erase(bit);
+			if (cell->type == ID($_AND_))
+				bit_lits[bit] = aig.add_and(bit_lits.at(fanins[0]), bit_lits.at(fanins[1]));
+			else
+				bit_lits[bit] = AigGraph::lit_not(bit_lits.at(fanins[0]));
+			stack.pop_back();
+		}
+		return bit_lits.at(root);
+	}
+
+	// Replaces the gates with the given graph, which must have the same
+	// inputs and outputs as `aig'.
+	void commit(const AigGraph &result)
+	{
+		log_assert(result.num_inputs() == aig.num_inputs());
+		log_assert(GetSize(result.outputs) == GetSize(aig.outputs));
+
+		for (auto cell : gates)
+			module->remove(cell);
+		gates.clear();
+
+		std::vector<RTLIL::SigBit> node_bits(result.size()), inv_bits(result.size());
+		std::vector<bool> has_bit(result.size()), has_inv(result.size());
+		node_bits[0] = State::S0;
+		inv_bits[0] = State::S1;
+		has_bit[0] = has_inv[0] = true;
+		for (int i = 0; i < result.num_inputs(); i++) {
+			node_bits[result.inputs[i]] = input_bits[i];
+			has_bit[result.inputs[i]] = true;
+		}
+
+		// Let AND gates drive an output directly where possible.
+		for (int i = 0; i < GetSize(result.outputs); i++) {
+			Lit lit = result.outputs[i];
+			int n = AigGraph::node(lit);
+			if (!AigGraph::is_compl(lit) && !has_bit[n]) {
+				node_bits[n] = output_bits[i];
+				has_bit[n] = true;
+			}
+		}
+
+		auto lit_bit = [&](Lit lit) {
+			int n = AigGraph::node(lit);
+			if (!AigGraph::is_compl(lit))
+				return node_bits[n];
+			if (!has_inv[n]) {
+				inv_bits[n] = module->addWire(NEW_ID);
+				has_inv[n] = true;
+				module->addNotGate(NEW_ID, node_bits[n], inv_bits[n]);
+			}
+			return inv_bits[n];
+		};
+
+		for (int n = 0; n < result.size(); n++) {
+			if (!result.is_and(n))
+				continue;
+			if (!has_bit[n]) {
+				node_bits[n] = module->addWire(NEW_ID);
+				has_bit[n] = true;
+			}
+			module->addAndGate(NEW_ID, lit_bit(result.fanin0[n]), lit_bit(result.fanin1[n]), node_bits[n]);
+		}
+
+		for (int i = 0; i < GetSize(result.outputs); i++) {
+			Lit lit = result.outputs[i];
+			int n = AigGraph::node(lit);
+			if (!AigGraph::is_compl(lit) && node_bits[n] == output_bits[i])
+				continue;
+			if (AigGraph::is_compl(lit) && !has_inv[n]) {
+				inv_bits[n] = output_bits[i];
+				has_inv[n] = true;
+				module->addNotGate(NEW_ID, node_bits[n], inv_bits[n]);
+				continue;
+			}
+			module->connect(output_bits[i], lit_bit(lit));
+		}
+	}
+};
+
+// Rebuilds the graph with each AND tree whose inner nodes have no other
+// fanout replaced by a tree of minimum depth.
+AigGraph aig_balance(const AigGraph &aig)
+{
+	std::vector<int> fanouts = aig.fanout_counts();
+	std::vector<std::vector<Lit>> leaves(aig.size());
+	std::vector<bool> needed(aig.size());
+	for (auto lit : aig.outputs)
+		needed[AigGraph::node(lit)] = true;
+
+	for (int n = aig.size() - 1; n > 0; n--) {
+		if (!needed[n] || !aig.is_and(n))
+			continue;
+		std::vector<Lit> stack = {aig.fanin0[n], aig.fanin1[n]};
+		while (!stack.empty()) {
+			Lit lit = stack.back();
+			int m = AigGraph::node(lit);
+			stack.pop_back();
+			if (!AigGraph::is_compl(lit) && aig.is_and(m) && fanouts[m] == 1) {
+				stack.push_back(aig.fanin0[m]);
+				stack.push_back(aig.fanin1[m]);
+			} else
+				leaves[n].push_back(lit);
+		}
+		std::sort(leaves[n].begin(), leaves[n].end());
+		leaves[n].erase(std::unique(leaves[n].begin(), leaves[n].end()), leaves[n].end());
+		for (int i = 0; i + 1 < GetSize(leaves[n]); i++)
+			if (leaves[n][i] == AigGraph::lit_not(leaves[n][i + 1]))
+				leaves[n] = {AigGraph::LIT_FALSE};
+		for (auto lit : leaves[n])
+			needed[AigGraph::node(lit)] = true;
+	}
+
+	AigGraph result;
+	std::vector<int> levels = {0};
+	std::vector<Lit> map(aig.size(), AigGraph::LIT_NONE);
+	map[0] = AigGraph::LIT_FALSE;
+	for (int n = 1; n < aig.size(); n++) {
+		if (!aig.is_and(n)) {
+			map[n] = result.add_input();
+			levels.push_back(0);
+			continue;
+		}
+		if (!needed[n])
+			continue;
+
+		// Combine the two shallowest operands until only one is left.
+		std::priority_queue<std::pair<int, Lit>, std::vector<std::pair<int, Lit>>, std::greater<std::pair<int, Lit>>> queue;
+		for (auto lit : leaves[n]) {
+			Lit new_lit = AigGraph::lit_not_cond(map[AigGraph::node(lit)], AigGraph::is_compl(lit));
+			queue.push({levels[AigGraph::node(new_lit)], new_lit});
+		}
+		while (GetSize(queue) > 1) {
+			Lit a = queue.top().second;
+			queue.pop();
+			Lit b = queue.top().second;
+			queue.pop();
+			Lit lit = result.add_and(a, b);
+			if (AigGraph::node(lit) == GetSize(levels))
+				levels.push_back(std::max(levels[AigGraph::node(a)], levels[AigGraph::node(b)]) + 1);
+			queue.push({levels[AigGraph::node(lit)], lit});
+		}
+		map[n] = queue.top().second;
+	}
+
+	for (auto lit : aig.outputs)
+		result.add_output(AigGraph::lit_not_cond(map[AigGraph::node(lit)], AigGraph::is_compl(lit)));
+	return result.cleanup();
+}
+
+// Builds the factored form of a sum of products over up to four leaves.
+// Bit 2*i of a cube selects leaf i, bit 2*i+1 its complement.
+template<typename Builder>
+Lit build_factored(Builder &builder, const std::vector<uint8_t> &cubes, const Lit *leaves)
+{
+	auto literal = [&](int l) {
+		return AigGraph::lit_not_cond(leaves[l >> 1], l & 1);
+	};
+	auto build_or = [&](Lit a, Lit b) {
+		return AigGraph::lit_not(builder.add_and(AigGraph::lit_not(a), AigGraph::lit_not(b)));
+	};
+
+	int best = -1, best_count = 1;
+	for (int l = 0; l < 8; l++) {
+		int count = 0;
+		for (auto cube : cubes)
+			if (cube & (1 << l))
+				count++;
+		if (count > best_count)
+			best = l, best_count = count;
+	}
+
+	if (best < 0) {
+		Lit result = AigGraph::LIT_FALSE;
+		for (auto cube : cubes) {
+			Lit product = AigGraph::LIT_TRUE;
+			for (int l = 0; l < 8; l++)
+				if (cube & (1 << l))
+					product = builder.add_and(product, literal(l));
+			result = build_or(result, product);
+		}
+		return result;
+	}
+
+	std::vector<uint8_t> quotient, remainder;
+	for (auto cube : cubes) {
+		if (cube & (1 << best))
+			quotient.push_back(cube & ~(1 << best));
+		else
+			remainder.push_back(cube);
+	}
+	Lit product = builder.add_and(literal(best), build_factored(builder, quotient, leaves));
+	return build_or(product, build_factored(builder, remainder, leaves));
+}
+
+static const uint16_t truth_vars[4] = {0xaaaa, 0xcccc, 0xf0f0, 0xff00};
+
+static uint16_t cofactor0(uint16_t truth, int var)
+{
+	uint16_t t = truth & ~truth_vars[var];
+	return t | t << (1 << var);
+}
+
+static uint16_t cofactor1(uint16_t truth, int var)
+{
+	uint16_t t = truth & truth_vars[var];
+	return t | t >> (1 << var);
+}
+
+// Computes an irredundant sum of products for a function between `on' and
+// `on_dc' with the Minato-Morreale algorithm, and returns the function of
+// the cover.
+static uint16_t isop(uint16_t on, uint16_t on_dc, int num_vars, std::vector<uint8_t> &cubes)
+{
+	if (on == 0)
+		return 0;
+	if (on_dc == 0xffff) {
+		cubes.push_back(0);
+		return 0xffff;
+	}
+
+	int var = num_vars - 1;
+	while (cofactor0(on, var) == cofactor1(on, var) && cofactor0(on_dc, var) == cofactor1(on_dc, var))
+		var--;
+	log_assert(var >= 0);
+
+	uint16_t on0 = cofactor0(on, var), on1 = cofactor1(on, var);
+	uint16_t dc0 = cofactor0(on_dc, var), dc1 = cofactor1(on_dc, var);
+
+	int start0 = GetSize(cubes);
+	uint16_t cover0 = isop(on0 & ~dc1, dc0, var, cubes);
+	int start1 = GetSize(cubes);
+	uint16_t cover1 = isop(on1 & ~dc0, dc1, var, cubes);
+	for (int i = start0; i < start1; i++)
+		cubes[i] |= 2 << (2 * var);
+	for (int i = start1; i < GetSize(cubes); i++)
+		cubes[i] |= 1 << (2 * var);
+
+	uint16_t cover = isop((on0 & ~cover0) | (on1 & ~cover1), dc0 & dc1, var, cubes);
+	return cover | (cover0 & ~truth_vars[var]) | (cover1 & truth_vars[var]);
+}
+
+// Replaces the cone of a node with a smaller implementation of its function
+// over one of its 4-input cuts, if that frees more nodes than it adds.
+struct AigRewriteWorker
+{
+	static const int max_cuts = 8;
+
+	struct Cut
+	{
+		int size;
+		int leaves[4];
+	};
+
+	struct Choice
+	{
+		Cut cut;
+		std::vector<uint8_t> cubes;
+		bool inverted;
+	};
+
+	// Counts the nodes an implementation would add to the original graph.
+	struct CostBuilder
+	{
+		const AigGraph &aig;
+		const std::vector<bool> &in_mffc;
+		dict<int64_t, Lit> new_nodes;
+		pool<int> reused;
+		int cost = 0;
+
+		CostBuilder(const AigGraph &aig, const std::vector<bool> &in_mffc) : aig(aig), in_mffc(in_mffc) { }
+
+		Lit add_and(Lit a, Lit b)
+		{
+			Lit result = AigGraph::trivial_and(a, b);
+			if (result != AigGraph::LIT_NONE)
+				return result;
+			if (AigGraph::node(b) < aig.size()) {
+				result = aig.lookup_and(a, b);
+				if (result != AigGraph::LIT_NONE) {
+					// The node would not be freed after all.
+					if (in_mffc[AigGraph::node(result)] && reused.insert(AigGraph::node(result)).second)
+						cost++;
+					return result;
+				}
+			}
+			int64_t key = int64_t(uint64_t(a) << 32 | b);
+			auto it = new_nodes.find(key);
+			if (it != new_nodes.end())
+				return it->second;
+			cost++;
+			result = AigGraph::make_lit(aig.size() + GetSize(new_nodes));
+			new_nodes[key] = result;
+			return result;
+		}
+	};
+
+	const AigGraph &aig;
+	std::vector<std::vector<Cut>> cuts;
+	std::vector<int> refs;
+	std::vector<bool> in_mffc;
+	dict<int, Choice> choices;
+
+	AigRewriteWorker(const AigGraph &aig) : aig(aig) { }
+
+	static bool cut_contains(const Cut &cut, int n)
+	{
+		for (int i = 0; i < cut.size; i++)
+			if (cut.leaves[i] == n)
+				return true;
+		return false;
+	}
+
+	static bool cut_subset(const Cut &a, const Cut &b)
+	{
+		for (int i = 0; i < a.size; i++)
+			if (!cut_contains(b, a.leaves[i]))
+				return false;
+		return true;
+	}
+
+	void enumerate_cuts(int n)
+	{
+		cuts[n].push_back(Cut{1, {n}});
+		if (!aig.is_and(n))
+			return;
+
+		std::vector<Cut> merged;
+		for (auto &cut0 : cuts[AigGraph::node(aig.fanin0[n])])
+		for (auto &cut1 : cuts[AigGraph::node(aig.fanin1[n])])
+		{
+			Cut cut = cut0;
+			bool feasible = true;
+			for (int i = 0; i < cut1.size && feasible; i++) {
+				if (cut_contains(cut, cut1.leaves[i]))
+					continue;
+				if (cut.size == 4) {
+					feasible = false;
+					continue;
+				}
+				// Keep the leaves sorted.
+				int k = cut.size++;
+				for (; k > 0 && cut.leaves[k - 1] > cut1.leaves[i]; k--)
+					cut.leaves[k] = cut.leaves[k - 1];
+				cut.leaves[k] = cut1.leaves[i];
+			}
+			if (!feasible)
+				continue;
+
+			bool dominated = false;
+			for (int i = 0; i < GetSize(merged) && !dominated; i++)
+				dominated = cut_subset(merged[i], cut);
+			if (dominated)
+				continue;
+			for (int i = GetSize(merged) - 1; i >= 0; i--)
+				if (cut_subset(cut, merged[i]))
+					merged.erase(merged.begin() + i);
+			merged.push_back(cut);
+		}
+
+		std::stable_sort(merged.begin(), merged.end(), [](const Cut &a, const Cut &b) {
+			return a.size < b.size;
+		});
+		if (GetSize(merged) > max_cuts)
+			merged.resize(max_cuts);
+		cuts[n].insert(cuts[n].end(), merged.begin(), merged.end());
+	}
+
+	uint16_t cut_truth(int root, const Cut &cut)
+	{
+		dict<int, uint16_t> values;
+		for (int i = 0; i < cut.size; i++)
+			values[cut.leaves[i]] = truth_vars[i];
+
+		std::vector<int> cone;
+		std::vector<int> stack = {root};
+		while (!stack.empty()) {
+			int n = stack.back();
+			stack.pop_back();
+			if (values.count(n))
+				continue;
+			values[n] = 0;
+			cone.push_back(n);
+			stack.push_back(AigGraph::node(aig.fanin0[n]));
+			stack.push_back(AigGraph::node(aig.fanin1[n]));
+		}
+
+		std::sort(cone.begin(), cone.end());
+		for (int n : cone) {
+			uint16_t a = values.at(AigGraph::node(aig.fanin0[n]));
+			uint16_t b = values.at(AigGraph::node(aig.fanin1[n]));
+			if (AigGraph::is_compl(aig.fanin0[n]))
+				a = ~a;
+			if (AigGraph::is_compl(aig.fanin1[n]))
+				b = ~b;
+			values[n] = a & b;
+		}
+		return values.at(root);
+	}
+
+	// Collects the nodes that would become unused if `root' was
+	// implemented directly from the leaves of `cut'.
+	void collect_mffc(int root, const Cut &cut, std::vector<int> &mffc)
+	{
+		mffc.push_back(root);
+		for (int i = GetSize(mffc) - 1; i < GetSize(mffc); i++)
+			for (auto lit : {aig.fanin0[mffc[i]], aig.fanin1[mffc[i]]}) {
+				int n = AigGraph::node(lit);
+				if (aig.is_and(n) && !cut_contains(cut, n) && --refs[n] == 0)
+					mffc.push_back(n);
+			}
+		for (int m : mffc)
+			for (auto lit : {aig.fanin0[m], aig.fanin1[m]}) {
+				int n = AigGraph::node(lit);
+				if (aig.is_and(n) && !cut_contains(cut, n))
+					refs[n]++;
+			}
+	}
+
+	void evaluate(int n)
+	{
+		int best_gain = 0;
+		Choice best;
+
+		std::vector<int> mffc;
+		for (int i = 1; i < GetSize(cuts[n]); i++) {
+			const Cut &cut = cuts[n][i];
+			mffc.clear();
+			collect_mffc(n, cut, mffc);
+			for (int m : mffc)
+				in_mffc[m] = true;
+
+			Lit leaves[4];
+			for (int k = 0; k < cut.size; k++)
+				leaves[k] = AigGraph::make_lit(cut.leaves[k]);
+
+			uint16_t truth = cut_truth(n, cut);
+			for (bool inverted : {false, true}) {
+				uint16_t function = inverted ? ~truth : truth;
+				std::vector<uint8_t> cubes;
+				isop(function, function, cut.size, cubes);
+				CostBuilder builder(aig, in_mffc);
+				build_factored(builder, cubes, leaves);
+				int gain = GetSize(mffc) - builder.cost;
+				if (gain > best_gain) {
+					best_gain = gain;
+					best.cut = cut;
+					best.cubes = cubes;
+					best.inverted = inverted;
+				}
+			}
+
+			for (int m : mffc)
+				in_mffc[m] = false;
+		}
+
+		if (best_gain > 0)
+			choices[n] = best;
+	}
+
+	AigGraph run()
+	{
+		cuts.resize(aig.size());
+		refs = aig.fanout_counts();
+		in_mffc.resize(aig.size());
+		for (int n = 1; n < aig.size(); n++) {
+			enumerate_cuts(n);
+			if (aig.is_and(n))
+				evaluate(n);
+		}
+
+		std::vector<bool> needed(aig.size());
+		for (auto lit : aig.outputs)
+			needed[AigGraph::node(lit)] = true;
+		for (int n = aig.size() - 1; n > 0; n--) {
+			if (!needed[n] || !aig.is_and(n))
+				continue;
+			auto it = choices.find(n);
+			if (it != choices.end()) {
+				for (int i = 0; i < it->second.cut.size; i++)
+					needed[it->second.cut.leaves[i]] = true;
+			} else {
+				needed[AigGraph::node(aig.fanin0[n])] = true;
+				needed[AigGraph::node(aig.fanin1[n])] = true;
+			}
+		}
+
+		AigGraph result;
+		std::vector<Lit> map(aig.size(), AigGraph::LIT_NONE);
+		map[0] = AigGraph::LIT_FALSE;
+		for (int n = 1; n < aig.size(); n++) {
+			if (!aig.is_and(n)) {
+				map[n] = result.add_input();
+				continue;
+			}
+			if (!needed[n])
+				continue;
+			auto it = choices.find(n);
+			if (it != choices.end()) {
+				const Choice &choice = it->second;
+				Lit leaves[4];
+				for (int i = 0; i < choice.cut.size; i++)
+					leaves[i] = map[choice.cut.leaves[i]];
+				map[n] = AigGraph::lit_not_cond(build_factored(result, choice.cubes, leaves), choice.inverted);
+			} else {
+				map[n] = result.add_and(AigGraph::lit_not_cond(map[AigGraph::node(aig.fanin0[n])], AigGraph::is_compl(aig.fanin0[n])),
+						AigGraph::lit_not_cond(map[AigGraph::node(aig.fanin1[n])], AigGraph::is_compl(aig.fanin1[n])));
+			}
+		}
+
+		for (auto lit : aig.outputs)
+			result.add_output(AigGraph::lit_not_cond(map[AigGraph::node(lit)], AigGraph::is_compl(lit)));
+		return result.cleanup();
+	}
+};
+
+// Merges nodes that are functionally equivalent up to complementation.
+// Candidates are found with random simulation and proven with SAT.
+AigGraph aig_fraig(const AigGraph &aig, int words, int max_tries)
+{
+	std::vector<uint64_t> values(aig.size() * words);
+	uint64_t state = 0x9e3779b97f4a7c15ULL;
+	for (int n : aig.inputs)
+		for (int k = 0; k < words; k++) {
+			state ^= state << 13;
+			state ^= state >> 7;
+			state ^= state << 17;
+			values[n * words + k] = state;
+		}
+	aig.simulate(values, words);
+
+	ezSatPtr ez;
+	std::vector<int> ez_nodes(aig.size());
+	auto ez_lit = [&](Lit lit) {
+		return AigGraph::is_compl(lit) ? ez->NOT(ez_nodes[AigGraph::node(lit)]) : ez_nodes[AigGraph::node(lit)];
+	};
+
+	// Nodes with the same simulation signature, bucketed by its hash.
+	dict<int, std::vector<int>> classes;
+	std::vector<Lit> repl(aig.size(), AigGraph::LIT_NONE);
+	int sat_calls = 0, merged = 0;
+
+	for (int n = 0; n < aig.size(); n++) {
+		if (n == 0)
+			ez_nodes[n] = ez->CONST_FALSE;
+		else if (aig.is_and(n))
+			ez_nodes[n] = ez->AND(ez_lit(aig.fanin0[n]), ez_lit(aig.fanin1[n]));
+		else
+			ez_nodes[n] = ez->frozen_literal();
+
+		// Normalize the phase so that complementary nodes share a class.
+		bool phase = values[n * words] & 1;
+		uint64_t mask = phase ? ~uint64_t(0) : 0;
+		unsigned int hash = mkhash_init;
+		for (int k = 0; k < words; k++) {
+			uint64_t word = values[n * words + k] ^ mask;
+			hash = mkhash(mkhash(hash, uint32_t(word)), uint32_t(word >> 32));
+		}
+
+		std::vector<int> &members = classes[int(hash)];
+		if (aig.is_and(n)) {
+			int tries = 0;
+			for (int m : members) {
+				bool inverted = phase != bool(values[m * words] & 1);
+				uint64_t diff = inverted ? ~uint64_t(0) : 0;
+				bool same_signature = true;
+				for (int k = 0; k < words && same_signature; k++)
+					same_signature = values[n * words + k] == (values[m * words + k] ^ diff);
+				if (!same_signature)
+					continue;
+				if (tries++ == max_tries)
+					break;
+				sat_calls++;
+				if (!ez->solve(ez->XOR(ez_nodes[n], inverted ? ez->NOT(ez_nodes[m]) : ez_nodes[m]))) {
+					repl[n] = AigGraph::make_lit(m, inverted);
+					merged++;
+					break;
+				}
+			}
+		}
+		if (repl[n] == AigGraph::LIT_NONE)
+			members.push_back(n);
+	}
+
+	log_debug("Merged %d nodes with %d SAT calls.\n", merged, sat_calls);
+
+	std::vector<bool> needed(aig.size());
+	for (auto lit : aig.outputs)
+		needed[AigGraph::node(lit)] = true;
+	for (int n = aig.size() - 1; n > 0; n--) {
+		if (!needed[n])
+			continue;
+		if (repl[n] != AigGraph::LIT_NONE)
+			needed[AigGraph::node(repl[n])] = true;
+		else if (aig.is_and(n)) {
+			needed[AigGraph::node(aig.fanin0[n])] = true;
+			needed[AigGraph::node(aig.fanin1[n])] = true;
+		}
+	}
+
+	AigGraph result;
+	std::vector<Lit> map(aig.size(), AigGraph::LIT_NONE);
+	map[0] = AigGraph::LIT_FALSE;
+	for (int n = 1; n < aig.size(); n++) {
+		if (!aig.is_and(n))
+			map[n] = result.add_input();
+		else if (!needed[n])
+			continue;
+		else if (repl[n] != AigGraph::LIT_NONE)
+			map[n] = AigGraph::lit_not_cond(map[AigGraph::node(repl[n])], AigGraph::is_compl(repl[n]));
+		else
+			map[n] = result.add_and(AigGraph::lit_not_cond(map[AigGraph::node(aig.fanin0[n])], AigGraph::is_compl(aig.fanin0[n])),
+					AigGraph::lit_not_cond(map[AigGraph::node(aig.fanin1[n])], AigGraph::is_compl(aig.fanin1[n])));
+	}
+
+	for (auto lit : aig.outputs)
+		result.add_output(AigGraph::lit_not_cond(map[AigGraph::node(lit)], AigGraph::is_compl(lit)));
+	return result.cleanup();
+}
+
+struct AigBalancePass : public Pass {
+	AigBalancePass() : Pass("aig_balance", "balance AND trees in an and-inverter graph") { }
+	void help() override
+	{
+		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
+		log("\n");
+		log("    aig_balance [selection]\n");
+		log("\n");
+		log("This pass reduces the depth of the $_AND_/$_NOT_ gates created by `aigmap'.\n");
+		log("Each tree of AND gates whose inner gates have no other fanout is rebuilt as\n");
+		log("a tree of minimum depth. The result is kept only if it reduces the depth, or\n");
+		log("the number of AND gates without increasing the depth.\n");
+		log("\n");
+		log("The pass works on an in-memory and-inverter graph and does not need ABC.\n");
+		log("\n");
+	}
+	void execute(std::vector<std::string> args, RTLIL::Design *design) override
+	{
+		log_header(design, "Executing AIG_BALANCE pass (balance and-inverter graph).\n");
+		extra_args(args, 1, design);
+
+		for (auto module : design->selected_modules())
+		{
+			AigModuleWorker worker(module);
+			if (worker.gates.empty())
+				continue;
+			AigGraph result = aig_balance(worker.aig);
+			int old_depth = worker.aig.depth(), new_depth = result.depth();
+			log("Module %s: %d AND gates with depth %d, balanced to %d AND gates with depth %d.\n", log_id(module),
+					worker.and_gates, old_depth, result.num_ands(), new_depth);
+			if (new_depth < old_depth || (new_depth == old_depth && result.num_ands() < worker.and_gates))
+				worker.commit(result);
+		}
+	}
+} AigBalancePass;
+
+struct AigRewritePass : public Pass {
+	AigRewritePass() : Pass("aig_rewrite", "rewrite cuts of an and-inverter graph") { }
+	void help() override
+	{
+		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
+		log("\n");
+		log("    aig_rewrite [selection]\n");
+		log("\n");
+		log("This pass reduces the number of $_AND_/$_NOT_ gates created by `aigmap'. For\n");
+		log("each gate, the function of each of its cuts with up to 4 inputs is computed,\n");
+		log("and the logic cone of the gate is replaced by the factored form of that\n");
+		log("function if this frees more gates than it adds, taking gates that can be\n");
+		log("shared with the rest of the graph into account. This is repeated until the\n");
+		log("number of gates no longer decreases.\n");
+		log("\n");
+		log("The pass works on an in-memory and-inverter graph and does not need ABC.\n");
+		log("\n");
+	}
+	void execute(std::vector<std::string> args, RTLIL::Design *design) override
+	{
+		log_header(design, "Executing AIG_REWRITE pass (rewrite and-inverter graph).\n");
+		extra_args(args, 1, design);
+
+		for (auto module : design->selected_modules())
+		{
+			AigModuleWorker worker(module);
+			if (worker.gates.empty())
+				continue;
+			AigGraph best = worker.aig;
+			while (1) {
+				AigGraph result = AigRewriteWorker(best).run();
+				if (result.num_ands() >= best.num_ands())
+					break;
+				best = std::move(result);
+			}
+			log("Module %s: rewrote %d AND gates into %d AND gates.\n", log_id(module),
+					worker.and_gates, best.num_ands());
+			if (best.num_ands() < worker.and_gates)
+				worker.commit(best);
+		}
+	}
+} AigRewritePass;
+
+struct AigFraigPass : public Pass {
+	AigFraigPass() : Pass("aig_fraig", "merge equivalent nodes of an and-inverter graph") { }
+	void help() override
+	{
+		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
+		log("\n");
+		log("    aig_fraig [options] [selection]\n");
+		log("\n");
+		log("This pass merges $_AND_/$_NOT_ gates created by `aigmap' that compute the same\n");
+		log("function or its complement, even if they are structurally different.\n");
+		log("Candidates are found by random simulation and each merge is proven with a\n");
+		log("SAT solver.\n");
+		log("\n");
+		log("    -words <n>\n");
+		log("        simulate 64*n random input patterns to find candidates. the default\n");
+		log("        is 16.\n");
+		log("\n");
+		log("    -tries <n>\n");
+		log("        compare each gate with at most n earlier candidates with the same\n");
+		log("        simulation signature. the default is 8.\n");
+		log("\n");
+		log("The pass works on an in-memory and-inverter graph and does not need ABC.\n");
+		log("\n");
+	}
+	void execute(std::vector<std::string> args, RTLIL::Design *design) override
+	{
+		int words = 16, max_tries = 8;
+
+		log_header(design, "Executing AIG_FRAIG pass (merge equivalent AIG nodes).\n");
+
+		size_t argidx;
+		for (argidx = 1; argidx < args.size(); argidx++)
+		{
+			if (args[argidx] == "-words" && argidx+1 < args.size()) {
+				words = std::max(atoi(args[++argidx].c_str()), 1);
+				continue;
+			}
+			if (args[argidx] == "-tries" && argidx+1 < args.size()) {
+				max_tries = std::max(atoi(args[++argidx].c_str()), 1);
+				continue;
+			}
+			break;
+		}
+		extra_args(args, argidx, design);
+
+		for (auto module : design->selected_modules())
+		{
+			AigModuleWorker worker(module);
+			if (worker.gates.empty())
+				continue;
+			AigGraph result = aig_fraig(worker.aig, words, max_tries);
+			log("Module %s: merged equivalent nodes, reducing %d AND gates to %d AND gates.\n", log_id(module),
+					worker.and_gates, result.num_ands());
+			if (result.num_ands() < worker.and_gates)
+				worker.commit(result);
+		}
+	}
+} AigFraigPass;
+
+PRIVATE_NAMESPACE_END
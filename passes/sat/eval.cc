@@ -450,6 +450,7 @@ struct EvalPass : public Pass {
 			log_cmd_error("Can't perform EVAL on an empty selection!\n");
 
 		ConstEval ce(module);
+		std::vector<RTLIL::SigSig> set_values;
 
 		for (auto &it : sets) {
 			RTLIL::SigSpec lhs, rhs;
@@ -463,6 +464,7 @@ struct EvalPass : public Pass {
 				log_cmd_error("Set expression with different lhs and rhs sizes: %s (%s, %d bits) vs. %s (%s, %d bits)\n",
 						it.first.c_str(), log_signal(lhs), lhs.size(), it.second.c_str(), log_signal(rhs), rhs.size());
 			ce.set(lhs, rhs.as_const());
+			set_values.push_back(RTLIL::SigSig(lhs, rhs));
 		}
 
 		if (shows.size() == 0) {
@@ -523,14 +525,37 @@ struct EvalPass : public Pass {
 			tab_line.clear();
 
 			RTLIL::Const tabvals(0, tabsigs.size());
+
+			// If every signal in the cone has a value, evaluate all rows at once with bit-sliced evaluation.
+			// Otherwise, use ConstEval, which only reports the missing values that are actually needed.
+			ConstEvalVec vec_ce(module);
+			for (auto &it : set_values)
+				vec_ce.set(it.first, it.second.as_const());
+			RTLIL::SigSpec vec_undef;
+			bool use_vec_ce = vec_ce.compile(tabsigs, signal, vec_undef) && vec_undef.empty();
+			std::vector<RTLIL::Const> vec_values;
+			int vec_row = 0;
+			if (use_vec_ce) {
+				std::vector<RTLIL::Const> vec_inputs;
+				do {
+					vec_inputs.push_back(tabvals);
+					tabvals = RTLIL::const_add(tabvals, RTLIL::Const(1), false, false, tabvals.bits.size());
+				} while (tabvals.as_bool());
+				use_vec_ce = vec_ce.eval(vec_inputs, vec_values);
+			}
+
 			do
 			{
 				ce.push();
-				ce.set(tabsigs, tabvals);
-				value = signal;
+				if (use_vec_ce) {
+					value = vec_values.at(vec_row++);
+				} else {
+					ce.set(tabsigs, tabvals);
+					value = signal;
+				}
 
 				RTLIL::SigSpec this_undef;
-				while (!ce.eval(value, this_undef)) {
+				while (!use_vec_ce && !ce.eval(value, this_undef)) {
 					if (!set_undef) {
 						log("Failed to evaluate signal %s at %s = %s: Missing value for %s.\n", log_signal(signal),
 								log_signal(tabsigs), log_signal(tabvals), log_signal(this_undef));
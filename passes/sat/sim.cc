@@ -20,6 +20,7 @@
 #include "kernel/yosys.h"
 #include "kernel/sigtools.h"
 #include "kernel/celltypes.h"
+#include "kernel/threading.h"
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -33,6 +34,286 @@ struct SimShared
 	int rstlen = 1;
 };
 
+// Output file that is written in large chunks, on a separate thread if possible, so that the simulation does
+// not wait for the file I/O.
+struct BufferedWriter
+{
+	std::ofstream f;
+	std::string buffer;
+	ConcurrentQueue<std::string> queue;
+	std::unique_ptr<ThreadPool> writer;
+
+	bool is_open() const
+	{
+		return f.is_open();
+	}
+
+	void open(const std::string &filename)
+	{
+		f.open(filename.c_str(), std::ofstream::binary);
+		if (f.fail())
+			log_cmd_error("Can't open output file `%s' for writing: %s\n", filename.c_str(), strerror(errno));
+		if (ThreadPool::pool_size(0, 1) > 0)
+			writer.reset(new ThreadPool(1, [this](int) {
+				std::string chunk;
+				while (queue.pop_front(chunk))
+					f << chunk;
+			}));
+	}
+
+	void flush(bool force = false)
+	{
+		if (buffer.empty() || (!force && buffer.size() < 65536))
+			return;
+		if (writer)
+			queue.push_back(std::move(buffer));
+		else
+			f << buffer;
+		buffer.clear();
+	}
+
+	void close()
+	{
+		if (!is_open())
+			return;
+		flush(true);
+		queue.close();
+		writer.reset();
+		f.close();
+	}
+
+	~BufferedWriter()
+	{
+		close();
+	}
+};
+
+// Streaming reader for the subset of VCD needed to replay and check simulation traces: only variables declared
+// directly in the outermost scope are tracked (by name), and real-valued changes are ignored.
+struct VcdReader
+{
+	std::ifstream f;
+	std::string filename;
+	dict<std::string, std::string> id_to_name;
+	dict<std::string, int> name_to_width;
+	std::string pending_time;
+
+	void open(const std::string &filename)
+	{
+		this->filename = filename;
+		f.open(filename.c_str());
+		if (f.fail())
+			log_cmd_error("Can't open VCD file `%s' for reading: %s\n", filename.c_str(), strerror(errno));
+
+		int depth = 0;
+		std::string token;
+		while (f >> token)
+		{
+			if (token == "$scope") {
+				depth++;
+				skip_to_end();
+			} else if (token == "$upscope") {
+				depth--;
+				skip_to_end();
+			} else if (token == "$var") {
+				std::string type, width, id, name;
+				f >> type >> width >> id >> name;
+				skip_to_end();
+				if (depth == 1) {
+					id_to_name[id] = name;
+					name_to_width[name] = atoi(width.c_str());
+				}
+			} else if (token == "$enddefinitions") {
+				skip_to_end();
+				return;
+			} else if (token[0] == '$') {
+				skip_to_end();
+			} else {
+				log_error("Unexpected token `%s' in the header of VCD file `%s'.\n", token.c_str(), filename.c_str());
+			}
+		}
+		log_error("Unexpected end of VCD file `%s'.\n", filename.c_str());
+	}
+
+	void skip_to_end()
+	{
+		std::string token;
+		while (f >> token)
+			if (token == "$end")
+				return;
+	}
+
+	static Const parse_value(const std::string &digits, int width)
+	{
+		Const value(State::S0, width);
+		// Values shorter than the variable are extended with 0, or with x/z if the leftmost digit is x/z.
+		State fill = State::S0;
+		if (!digits.empty() && (digits[0] == 'x' || digits[0] == 'X'))
+			fill = State::Sx;
+		if (!digits.empty() && (digits[0] == 'z' || digits[0] == 'Z'))
+			fill = State::Sz;
+		for (int i = 0; i < width; i++) {
+			if (i >= GetSize(digits)) {
+				value.bits[i] = fill;
+				continue;
+			}
+			switch (digits[GetSize(digits) - 1 - i]) {
+				case '0': value.bits[i] = State::S0; break;
+				case '1': value.bits[i] = State::S1; break;
+				case 'z': case 'Z': value.bits[i] = State::Sz; break;
+				default: value.bits[i] = State::Sx;
+			}
+		}
+		return value;
+	}
+
+	// Reads the changes of the next time step. The changes before the first timestamp (if any) are reported
+	// as belonging to time 0.
+	bool next_step(uint64_t &time, dict<std::string, Const> &changes)
+	{
+		changes.clear();
+		bool have_step = false;
+		if (!pending_time.empty()) {
+			time = std::stoull(pending_time);
+			pending_time.clear();
+			have_step = true;
+		}
+
+		std::string token;
+		while (f >> token)
+		{
+			std::string digits, id;
+			if (token[0] == '#') {
+				if (have_step) {
+					pending_time = token.substr(1);
+					return true;
+				}
+				time = std::stoull(token.substr(1));
+				have_step = true;
+				continue;
+			} else if (token == "$comment") {
+				skip_to_end();
+				continue;
+			} else if (token[0] == '$') {
+				// $dumpvars, $dumpall, $dumpon, $dumpoff and their $end
+				continue;
+			} else if (token[0] == 'b' || token[0] == 'B') {
+				digits = token.substr(1);
+				f >> id;
+			} else if (token[0] == 'r' || token[0] == 'R') {
+				f >> id;
+				continue;
+			} else {
+				digits = token.substr(0, 1);
+				id = token.substr(1);
+			}
+
+			if (!have_step) {
+				time = 0;
+				have_step = true;
+			}
+			auto it = id_to_name.find(id);
+			if (it != id_to_name.end())
+				changes[it->second] = parse_value(digits, name_to_width.at(it->second));
+		}
+		return have_step;
+	}
+};
+
+// Contents of a memory, stored as pages of words that are only allocated once a word in them is written. Words in
+// pages that were never written are read from the initialization value, so simulating a large memory only needs
+// storage proportional to the number of pages that are actually written.
+struct SparseMemory
+{
+	static const int page_words = 64;
+
+	int width = 0, size = 0;
+	bool zinit = false;
+	Const init;
+	dict<int, std::vector<State>> pages;
+
+	void setup(const Const &init_value, int width, int size)
+	{
+		this->width = width;
+		this->size = size;
+		init = init_value;
+		if (GetSize(init) > int64_t(width) * size)
+			init.bits.resize(width * size);
+		// Undefined words at the end of the initialization value are the same as no initialization value.
+		while (GetSize(init) > 0 && init.bits.back() == State::Sx)
+			init.bits.pop_back();
+	}
+
+	State init_bit(int64_t offset) const
+	{
+		State bit = offset < GetSize(init) ? init.bits[offset] : State::Sx;
+		if (zinit && bit != State::S1)
+			bit = State::S0;
+		return bit;
+	}
+
+	Const read(int index) const
+	{
+		Const data;
+		data.bits.reserve(width);
+		auto it = pages.find(index / page_words);
+		if (it != pages.end()) {
+			auto begin = it->second.begin() + (index % page_words) * width;
+			data.bits.insert(data.bits.end(), begin, begin + width);
+		} else {
+			for (int i = 0; i < width; i++)
+				data.bits.push_back(init_bit(int64_t(index) * width + i));
+		}
+		return data;
+	}
+
+	std::vector<State> &materialize_page(int page_index)
+	{
+		std::vector<State> &page = pages[page_index];
+		int64_t first_bit = int64_t(page_index) * page_words * width;
+		page.reserve(page_words * width);
+		for (int i = 0; i < page_words * width; i++)
+			page.push_back(init_bit(first_bit + i));
+		return page;
+	}
+
+	// Writes the bits of `data` for which `enable` is 1. Returns true if anything changed.
+	bool write(int index, const Const &data, const Const &enable)
+	{
+		std::vector<State> *page = nullptr;
+		auto it = pages.find(index / page_words);
+		if (it != pages.end())
+			page = &it->second;
+
+		bool changed = false;
+		for (int i = 0; i < width; i++)
+		{
+			if (enable[i] != State::S1)
+				continue;
+			int offset = (index % page_words) * width + i;
+			State current = page ? (*page)[offset] : init_bit(int64_t(index) * width + i);
+			if (current == data[i])
+				continue;
+			if (page == nullptr)
+				page = &materialize_page(index / page_words);
+			(*page)[offset] = data[i];
+			changed = true;
+		}
+		return changed;
+	}
+
+	Const to_const() const
+	{
+		Const data;
+		data.bits.reserve(width * size);
+		for (int index = 0; index < size; index++) {
+			Const word = read(index);
+			data.bits.insert(data.bits.end(), word.bits.begin(), word.bits.end());
+		}
+		return data;
+	}
+};
+
 void zinit(State &v)
 {
 	if (v != State::S1)
@@ -76,7 +357,7 @@ struct SimInstance
 		Const past_wr_en;
 		Const past_wr_addr;
 		Const past_wr_data;
-		Const data;
+		SparseMemory data;
 	};
 
 	dict<Cell*, ff_state_t> ff_database;
@@ -152,14 +433,7 @@ struct SimInstance
 				mem.past_wr_addr = Const(State::Sx, GetSize(cell->getPort(ID::WR_ADDR)));
 				mem.past_wr_data = Const(State::Sx, GetSize(cell->getPort(ID::WR_DATA)));
 
-				mem.data = cell->getParam(ID::INIT);
-				int sz = cell->getParam(ID::SIZE).as_int() * cell->getParam(ID::WIDTH).as_int();
-
-				if (GetSize(mem.data) > sz)
-					mem.data.bits.resize(sz);
-
-				while (GetSize(mem.data) < sz)
-					mem.data.bits.push_back(State::Sx);
+				mem.data.setup(cell->getParam(ID::INIT), cell->getParam(ID::WIDTH).as_int(), cell->getParam(ID::SIZE).as_int());
 
 				mem_database[cell] = mem;
 			}
@@ -189,7 +463,7 @@ struct SimInstance
 			for (auto &it : mem_database) {
 				mem_state_t &mem = it.second;
 				zinit(mem.past_wr_en);
-				zinit(mem.data);
+				mem.data.zinit = true;
 			}
 		}
 	}
@@ -284,7 +558,7 @@ struct SimInstance
 				if (addr.is_fully_def()) {
 					int index = addr.as_int() - offset;
 					if (index >= 0 && index < size)
-						data = mem.data.extract(index*width, width);
+						data = mem.data.read(index);
 				}
 
 				set_state(rd_data_sig.extract(port_idx*width, width), data);
@@ -465,13 +739,10 @@ struct SimInstance
 				if (addr.is_fully_def())
 				{
 					int index = addr.as_int() - offset;
-					if (index >= 0 && index < size)
-						for (int i = 0; i < width; i++)
-							if (enable[i] == State::S1 && mem.data.bits.at(index*width+i) != data[i]) {
-								mem.data.bits.at(index*width+i) = data[i];
-								dirty_cells.insert(cell);
-								did_something = true;
-							}
+					if (index >= 0 && index < size && mem.data.write(index, data, enable)) {
+						dirty_cells.insert(cell);
+						did_something = true;
+					}
 				}
 			}
 		}
@@ -563,7 +834,7 @@ struct SimInstance
 		{
 			Cell *cell = it.first;
 			mem_state_t &mem = it.second;
-			Const initval = mem.data;
+			Const initval = mem.data.to_const();
 
 			while (GetSize(initval) >= 2) {
 				if (initval[GetSize(initval)-1] != State::Sx) break;
@@ -578,26 +849,26 @@ struct SimInstance
 			it.second->writeback(wbmods);
 	}
 
-	void write_vcd_header(std::ofstream &f, int &id)
+	void write_vcd_header(std::string &f, int &id)
 	{
-		f << stringf("$scope module %s $end\n", log_id(name()));
+		f += stringf("$scope module %s $end\n", log_id(name()));
 
 		for (auto wire : module->wires())
 		{
 			if (shared->hide_internal && wire->name[0] == '$')
 				continue;
 
-			f << stringf("$var wire %d n%d %s%s $end\n", GetSize(wire), id, wire->name[0] == '$' ? "\\" : "", log_id(wire));
+			f += stringf("$var wire %d n%d %s%s $end\n", GetSize(wire), id, wire->name[0] == '$' ? "\\" : "", log_id(wire));
 			vcd_database[wire] = make_pair(id++, Const());
 		}
 
 		for (auto child : children)
 			child.second->write_vcd_header(f, id);
 
-		f << stringf("$upscope $end\n");
+		f += "$upscope $end\n";
 	}
 
-	void write_vcd_step(std::ofstream &f)
+	void write_vcd_step(std::string &f)
 	{
 		for (auto &it : vcd_database)
 		{
@@ -610,17 +881,19 @@ struct SimInstance
 
 			it.second.second = value;
 
-			f << "b";
+			f += 'b';
 			for (int i = GetSize(value)-1; i >= 0; i--) {
 				switch (value[i]) {
-					case State::S0: f << "0"; break;
-					case State::S1: f << "1"; break;
-					case State::Sx: f << "x"; break;
-					default: f << "z";
+					case State::S0: f += '0'; break;
+					case State::S1: f += '1'; break;
+					case State::Sx: f += 'x'; break;
+					default: f += 'z';
 				}
 			}
 
-			f << stringf(" n%d\n", id);
+			f += " n";
+			f += std::to_string(id);
+			f += '\n';
 		}
 
 		for (auto child : children)
@@ -631,7 +904,13 @@ struct SimInstance
 struct SimWorker : SimShared
 {
 	SimInstance *top = nullptr;
-	std::ofstream vcdfile;
+	BufferedWriter vcdfile;
+	VcdReader stimulus, reference;
+	bool use_stimulus = false, use_reference = false;
+	dict<std::string, Const> reference_values, reference_changes;
+	uint64_t reference_time = 0;
+	bool reference_pending = false;
+	int mismatches = 0;
 	pool<IdString> clock, clockn, reset, resetn;
 
 	~SimWorker()
@@ -645,18 +924,65 @@ struct SimWorker : SimShared
 			return;
 
 		int id = 1;
-		top->write_vcd_header(vcdfile, id);
+		top->write_vcd_header(vcdfile.buffer, id);
 
-		vcdfile << stringf("$enddefinitions $end\n");
+		vcdfile.buffer += "$enddefinitions $end\n";
 	}
 
-	void write_vcd_step(int t)
+	void write_vcd_step(uint64_t t)
 	{
+		check_step(t);
+
 		if (!vcdfile.is_open())
 			return;
 
-		vcdfile << stringf("#%d\n", t);
-		top->write_vcd_step(vcdfile);
+		vcdfile.buffer += '#';
+		vcdfile.buffer += std::to_string(t);
+		vcdfile.buffer += '\n';
+		top->write_vcd_step(vcdfile.buffer);
+		vcdfile.flush();
+	}
+
+	// Compares the top-level outputs with the values the reference trace has at time `t`. Bits that are
+	// undefined in the reference are not compared.
+	void check_step(uint64_t t)
+	{
+		if (!use_reference)
+			return;
+
+		while (1)
+		{
+			if (!reference_pending) {
+				if (!reference.next_step(reference_time, reference_changes))
+					break;
+				reference_pending = true;
+			}
+			if (reference_time > t)
+				break;
+			for (auto &it : reference_changes)
+				reference_values[it.first] = it.second;
+			reference_pending = false;
+		}
+
+		for (auto wire : top->module->wires())
+		{
+			if (!wire->port_output)
+				continue;
+
+			auto it = reference_values.find(log_id(wire));
+			if (it == reference_values.end())
+				continue;
+
+			Const expected = it->second;
+			Const actual = top->get_state(wire);
+			for (int i = 0; i < GetSize(wire) && i < GetSize(expected); i++)
+				if ((expected[i] == State::S0 || expected[i] == State::S1) && actual[i] != expected[i]) {
+					log_warning("Output %s differs from the reference at time %llu: expected %s, got %s.\n",
+							log_id(wire), (unsigned long long)t, log_signal(expected), log_signal(actual));
+					mismatches++;
+					break;
+				}
+		}
 	}
 
 	void update()
@@ -694,6 +1020,65 @@ struct SimWorker : SimShared
 		}
 	}
 
+	void run_stimulus(Module *topmod)
+	{
+		log_assert(top == nullptr);
+		top = new SimInstance(this, topmod);
+
+		dict<std::string, Wire*> inports;
+		for (auto wire : topmod->wires())
+			if (wire->port_input) {
+				if (!stimulus.name_to_width.count(log_id(wire)))
+					log_warning("Input %s is not driven by the stimulus, keeping it undefined.\n", log_id(wire));
+				inports[log_id(wire)] = wire;
+			}
+
+		bool first_step = true;
+		uint64_t time;
+		dict<std::string, Const> changes;
+		while (stimulus.next_step(time, changes))
+		{
+			if (debug)
+				log("\n===== %llu =====\n", (unsigned long long)time);
+			else
+				log_debug("Simulating time %llu.\n", (unsigned long long)time);
+
+			for (auto &it : changes) {
+				auto port_it = inports.find(it.first);
+				if (port_it == inports.end())
+					continue;
+				Const value = it.second;
+				value.bits.resize(GetSize(port_it->second), State::Sx);
+				top->set_state(port_it->second, value);
+			}
+
+			update();
+
+			if (first_step)
+				write_vcd_header();
+			first_step = false;
+			write_vcd_step(time);
+		}
+
+		finish();
+	}
+
+	void finish()
+	{
+		vcdfile.close();
+
+		if (use_reference) {
+			if (mismatches != 0)
+				log_error("Found %d mismatches between the simulation and the reference trace.\n", mismatches);
+			log("Simulation matches the reference trace.\n");
+		}
+
+		if (writeback) {
+			pool<Module*> wbmods;
+			top->writeback(wbmods);
+		}
+	}
+
 	void run(Module *topmod, int numcycles)
 	{
 		log_assert(top == nullptr);
@@ -745,10 +1130,7 @@ struct SimWorker : SimShared
 
 		write_vcd_step(10*numcycles + 2);
 
-		if (writeback) {
-			pool<Module*> wbmods;
-			top->writeback(wbmods);
-		}
+		finish();
 	}
 };
 
@@ -763,7 +1145,24 @@ struct SimPass : public Pass {
 		log("This command simulates the circuit using the given top-level module.\n");
 		log("\n");
 		log("    -vcd <filename>\n");
-		log("        write the simulation results to the given VCD file\n");
+		log("        write the simulation results to the given VCD file. if threads are\n");
+		log("        available, the file is written on a separate thread.\n");
+		log("\n");
+		log("    -stimulus <filename>\n");
+		log("        instead of toggling the clock and reset inputs, replay the values of\n");
+		log("        the top-level inputs from the given VCD file. the design is evaluated\n");
+		log("        at every timestamp of the file. only variables declared directly in\n");
+		log("        the outermost scope of the file are used, and are matched to inputs\n");
+		log("        by name. the options -clock, -clockn, -reset, -resetn, -rstlen and -n\n");
+		log("        are ignored.\n");
+		log("\n");
+		log("    -compare <filename>\n");
+		log("        compare the values of the top-level outputs with the values of the\n");
+		log("        variables with the same names in the outermost scope of the given VCD\n");
+		log("        file at every simulated timestamp (bits that are undefined in the file\n");
+		log("        are not compared). a file written with -vcd for the same top-level\n");
+		log("        ports can be used as reference, e.g. to check a synthesized netlist\n");
+		log("        against the RTL. an error is reported if any of the outputs differ.\n");
 		log("\n");
 		log("    -clock <portname>\n");
 		log("        name of top-level clock input\n");
@@ -806,7 +1205,17 @@ struct SimPass : public Pass {
 		size_t argidx;
 		for (argidx = 1; argidx < args.size(); argidx++) {
 			if (args[argidx] == "-vcd" && argidx+1 < args.size()) {
-				worker.vcdfile.open(args[++argidx].c_str());
+				worker.vcdfile.open(args[++argidx]);
+				continue;
+			}
+			if (args[argidx] == "-stimulus" && argidx+1 < args.size()) {
+				worker.stimulus.open(args[++argidx]);
+				worker.use_stimulus = true;
+				continue;
+			}
+			if (args[argidx] == "-compare" && argidx+1 < args.size()) {
+				worker.reference.open(args[++argidx]);
+				worker.use_reference = true;
 				continue;
 			}
 			if (args[argidx] == "-n" && argidx+1 < args.size()) {
@@ -867,7 +1276,10 @@ struct SimPass : public Pass {
 			top_mod = mods.front();
 		}
 
-		worker.run(top_mod, numcycles);
+		if (worker.use_stimulus)
+			worker.run_stimulus(top_mod);
+		else
+			worker.run(top_mod, numcycles);
 	}
 } SimPass;
 
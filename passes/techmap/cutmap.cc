@@ -0,0 +1,621 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+// [[CITE]] Priority cuts
+// Alan Mishchenko, Sungmin Cho, Satrajit Chatterjee, Robert Brayton, "Combinational and Sequential Mapping
+// with Priority Cuts," Proc. ICCAD 2007, pp. 354-361.
+// doi: 10.1109/ICCAD.2007.4397290
+
+// [[CITE]] Area flow and exact area recovery
+// Alan Mishchenko, Satrajit Chatterjee, Robert Brayton, "Improvements to Technology Mapping for LUT-Based
+// FPGAs," IEEE Transactions on Computer-Aided Design, Vol. 26, pp. 240-253, Feb. 2007.
+// doi: 10.1109/TCAD.2006.887925
+
+#include "kernel/yosys.h"
+#include "kernel/sigtools.h"
+
+USING_YOSYS_NAMESPACE
+PRIVATE_NAMESPACE_BEGIN
+
+struct CutmapWorker
+{
+	struct Cut
+	{
+		// Sorted indices of the nodes feeding the LUT.
+		std::vector<int> leaves;
+		int depth;
+		float area_flow;
+	};
+
+	struct Node
+	{
+		// The gate driving this node, or nullptr for primary inputs and constants.
+		RTLIL::Cell *cell = nullptr;
+		RTLIL::SigBit bit;
+		std::vector<int> fanins;
+		// Priority cuts of a gate; the first one is the cut currently selected for mapping.
+		std::vector<Cut> cuts;
+		int fanouts = 0;
+		int map_refs = 0;
+		int depth = 0;
+		float area_flow = 0;
+		int required = INT_MAX;
+		bool is_output = false;
+	};
+
+	enum Mode {
+		MODE_DEPTH,
+		MODE_AREA_FLOW,
+		MODE_EXACT_AREA,
+	};
+
+	RTLIL::Module *module;
+	SigMap sigmap;
+	int lut_size, max_cuts;
+
+	std::vector<Node> nodes;
+	dict<RTLIL::SigBit, int> bit_nodes;
+	// Gate nodes in topological order.
+	std::vector<int> gates;
+	int target_depth = 0;
+
+	int gate_count = 0, lut_count = 0, depth = 0;
+
+	static bool is_gate_type(RTLIL::IdString type)
+	{
+		return type.in(ID($_BUF_), ID($_NOT_), ID($_AND_), ID($_NAND_), ID($_OR_), ID($_NOR_), ID($_XOR_), ID($_XNOR_),
+				ID($_ANDNOT_), ID($_ORNOT_), ID($_MUX_), ID($_NMUX_));
+	}
+
+	static uint64_t eval_gate(RTLIL::IdString type, const uint64_t *in)
+	{
+		if (type == ID($_BUF_))
+			return in[0];
+		if (type == ID($_NOT_))
+			return ~in[0];
+		if (type == ID($_AND_))
+			return in[0] & in[1];
+		if (type == ID($_NAND_))
+			return ~(in[0] & in[1]);
+		if (type == ID($_OR_))
+			return in[0] | in[1];
+		if (type == ID($_NOR_))
+			return ~(in[0] | in[1]);
+		if (type == ID($_XOR_))
+			return in[0] ^ in[1];
+		if (type == ID($_XNOR_))
+			return ~(in[0] ^ in[1]);
+		if (type == ID($_ANDNOT_))
+			return in[0] & ~in[1];
+		if (type == ID($_ORNOT_))
+			return in[0] | ~in[1];
+		if (type == ID($_MUX_))
+			return (in[0] & ~in[2]) | (in[1] & in[2]);
+		if (type == ID($_NMUX_))
+			return ~((in[0] & ~in[2]) | (in[1] & in[2]));
+		log_abort();
+	}
+
+	int node(RTLIL::SigBit bit)
+	{
+		auto it = bit_nodes.find(bit);
+		if (it != bit_nodes.end())
+			return it->second;
+		int index = GetSize(nodes);
+		nodes.emplace_back();
+		nodes.back().bit = bit;
+		bit_nodes[bit] = index;
+		return index;
+	}
+
+	bool is_gate(int n) const
+	{
+		return nodes[n].cell != nullptr;
+	}
+
+	bool is_const(int n) const
+	{
+		return nodes[n].bit.wire == nullptr;
+	}
+
+	void discover_nodes()
+	{
+		std::vector<RTLIL::Cell*> gate_cells;
+		pool<RTLIL::Cell*> other_cells;
+
+		for (auto cell : module->cells()) {
+			if (!module->design->selected(module, cell) || !is_gate_type(cell->type) || cell->get_bool_attribute(ID::keep)) {
+				other_cells.insert(cell);
+				continue;
+			}
+			RTLIL::SigBit bit = sigmap(cell->getPort(ID::Y)[0]);
+			int n = node(bit);
+			if (is_gate(n) || is_const(n)) {
+				other_cells.insert(cell);
+				continue;
+			}
+			nodes[n].cell = cell;
+			gate_cells.push_back(cell);
+		}
+
+		for (auto cell : gate_cells) {
+			int n = bit_nodes.at(sigmap(cell->getPort(ID::Y)[0]));
+			std::vector<int> fanins;
+			for (auto port : {ID::A, ID::B, ID::S})
+				if (cell->hasPort(port))
+					fanins.push_back(node(sigmap(cell->getPort(port)[0])));
+			nodes[n].fanins = fanins;
+		}
+
+		// Everything observed outside of the mapped gates must be driven by a LUT.
+		for (auto cell : other_cells)
+			for (auto &conn : cell->connections())
+				for (auto bit : sigmap(conn.second))
+					if (bit_nodes.count(bit))
+						nodes[bit_nodes.at(bit)].is_output = true;
+		for (auto wire : module->wires())
+			if (wire->port_output || wire->get_bool_attribute(ID::keep))
+				for (auto bit : sigmap(wire))
+					if (bit_nodes.count(bit))
+						nodes[bit_nodes.at(bit)].is_output = true;
+		for (auto &conn : module->connections())
+			for (auto bit : sigmap(conn.second))
+				if (bit_nodes.count(bit))
+					nodes[bit_nodes.at(bit)].is_output = true;
+
+		// Sort the gates topologically.
+		std::vector<int> state(GetSize(nodes));
+		for (auto cell : gate_cells) {
+			int root = bit_nodes.at(sigmap(cell->getPort(ID::Y)[0]));
+			if (state[root] != 0)
+				continue;
+			std::vector<std::pair<int, int>> stack = {{root, 0}};
+			state[root] = 1;
+			while (!stack.empty()) {
+				int n = stack.back().first;
+				int &next = stack.back().second;
+				if (next < GetSize(nodes[n].fanins)) {
+					int f = nodes[n].fanins[next++];
+					if (!is_gate(f) || state[f] == 2)
+						continue;
+					if (state[f] == 1)
+						log_error("Found combinational loop through %s in module %s.\n", log_signal(nodes[f].bit), log_id(module));
+					state[f] = 1;
+					stack.push_back({f, 0});
+					continue;
+				}
+				state[n] = 2;
+				gates.push_back(n);
+				stack.pop_back();
+			}
+		}
+
+		for (int n : gates) {
+			for (int f : nodes[n].fanins)
+				nodes[f].fanouts++;
+			if (nodes[n].is_output)
+				nodes[n].fanouts++;
+		}
+
+		gate_count = GetSize(gates);
+	}
+
+	float leaf_refs(int n, Mode mode) const
+	{
+		if (mode == MODE_DEPTH)
+			return std::max(nodes[n].fanouts, 1);
+		return std::max((nodes[n].fanouts + nodes[n].map_refs) / 2.0f, 1.0f);
+	}
+
+	void evaluate_cut(Cut &cut, Mode mode) const
+	{
+		cut.depth = 0;
+		cut.area_flow = 1;
+		for (int l : cut.leaves) {
+			cut.depth = std::max(cut.depth, nodes[l].depth);
+			if (is_gate(l))
+				cut.area_flow += nodes[l].area_flow / leaf_refs(l, mode);
+		}
+		cut.depth++;
+	}
+
+	static bool merge_leaves(const std::vector<int> &a, const std::vector<int> &b, std::vector<int> &result, int limit)
+	{
+		result.clear();
+		auto i = a.begin(), j = b.begin();
+		while (i != a.end() || j != b.end()) {
+			if (j == b.end() || (i != a.end() && *i < *j))
+				result.push_back(*i++);
+			else if (i == a.end() || *j < *i)
+				result.push_back(*j++);
+			else
+				result.push_back(*i++), j++;
+			if (GetSize(result) > limit)
+				return false;
+		}
+		return true;
+	}
+
+	static bool dominates(const std::vector<int> &a, const std::vector<int> &b)
+	{
+		return a.size() <= b.size() && std::includes(b.begin(), b.end(), a.begin(), a.end());
+	}
+
+	// Computes the priority cuts of a gate from the priority cuts of its fanins. The previously selected cut
+	// is kept as a candidate, so that the quality of the mapping never degrades from one pass to the next.
+	void enumerate_cuts(int n, Mode mode)
+	{
+		Node &nd = nodes[n];
+
+		std::vector<std::vector<int>> partial = {{}};
+		std::vector<int> merged;
+		for (int f : nd.fanins) {
+			std::vector<const std::vector<int>*> options;
+			std::vector<int> trivial = {f};
+			if (!is_const(f)) {
+				options.push_back(&trivial);
+				for (auto &cut : nodes[f].cuts)
+					options.push_back(&cut.leaves);
+			}
+			if (options.empty())
+				continue;
+			std::vector<std::vector<int>> next;
+			pool<std::vector<int>> seen;
+			for (auto &p : partial)
+				for (auto o : options)
+					if (merge_leaves(p, *o, merged, lut_size) && seen.insert(merged).second)
+						next.push_back(merged);
+			partial.swap(next);
+		}
+		if (!nd.cuts.empty()) {
+			auto &prev = nd.cuts.front().leaves;
+			if (std::find(partial.begin(), partial.end(), prev) == partial.end())
+				partial.push_back(prev);
+		}
+
+		std::sort(partial.begin(), partial.end(), [](const std::vector<int> &a, const std::vector<int> &b) {
+			return a.size() < b.size();
+		});
+		std::vector<Cut> cuts;
+		for (auto &leaves : partial) {
+			bool dominated = false;
+			for (auto &cut : cuts)
+				if (dominates(cut.leaves, leaves)) {
+					dominated = true;
+					break;
+				}
+			if (dominated)
+				continue;
+			Cut cut;
+			cut.leaves = leaves;
+			evaluate_cut(cut, mode);
+			cuts.push_back(cut);
+		}
+
+		int required = mode == MODE_DEPTH ? INT_MAX : nd.required;
+		std::sort(cuts.begin(), cuts.end(), [&](const Cut &a, const Cut &b) {
+			bool a_late = a.depth > required, b_late = b.depth > required;
+			if (a_late != b_late)
+				return b_late;
+			if (mode == MODE_DEPTH || a_late) {
+				if (a.depth != b.depth)
+					return a.depth < b.depth;
+				if (a.area_flow != b.area_flow)
+					return a.area_flow < b.area_flow;
+			} else {
+				if (a.area_flow != b.area_flow)
+					return a.area_flow < b.area_flow;
+				if (a.depth != b.depth)
+					return a.depth < b.depth;
+			}
+			return a.leaves.size() < b.leaves.size();
+		});
+		if (GetSize(cuts) > max_cuts)
+			cuts.resize(max_cuts);
+
+		nd.cuts.swap(cuts);
+		nd.depth = nd.cuts.front().depth;
+		nd.area_flow = nd.cuts.front().area_flow;
+	}
+
+	int cut_ref(const Cut &cut)
+	{
+		int area = 1;
+		for (int l : cut.leaves)
+			if (is_gate(l) && nodes[l].map_refs++ == 0)
+				area += cut_ref(nodes[l].cuts.front());
+		return area;
+	}
+
+	int cut_deref(const Cut &cut)
+	{
+		int area = 1;
+		for (int l : cut.leaves)
+			if (is_gate(l) && --nodes[l].map_refs == 0)
+				area += cut_deref(nodes[l].cuts.front());
+		return area;
+	}
+
+	// Selects for every gate the cut that adds the fewest LUTs to the current mapping, without exceeding the
+	// required time of the gate.
+	void exact_area_pass()
+	{
+		for (int n : gates) {
+			Node &nd = nodes[n];
+			bool mapped = nd.map_refs > 0;
+			if (mapped)
+				cut_deref(nd.cuts.front());
+
+			int best = 0, best_area = INT_MAX, best_depth = INT_MAX;
+			for (int i = 0; i < GetSize(nd.cuts); i++) {
+				Cut &cut = nd.cuts[i];
+				evaluate_cut(cut, MODE_EXACT_AREA);
+				if (cut.depth > nd.required)
+					continue;
+				int area = cut_ref(cut);
+				cut_deref(cut);
+				if (area < best_area || (area == best_area && cut.depth < best_depth)) {
+					best = i;
+					best_area = area;
+					best_depth = cut.depth;
+				}
+			}
+			std::swap(nd.cuts.front(), nd.cuts[best]);
+			nd.depth = nd.cuts.front().depth;
+			nd.area_flow = nd.cuts.front().area_flow;
+
+			if (mapped)
+				cut_ref(nd.cuts.front());
+		}
+	}
+
+	// Recomputes reference counts and required times for the cover selected by the first cut of every gate.
+	// Returns the number of LUTs in the cover.
+	int update_mapping()
+	{
+		for (auto &nd : nodes) {
+			nd.map_refs = 0;
+			nd.required = INT_MAX;
+		}
+
+		depth = 0;
+		for (int n : gates)
+			if (nodes[n].is_output) {
+				nodes[n].map_refs++;
+				depth = std::max(depth, nodes[n].depth);
+			}
+		if (target_depth == 0)
+			target_depth = depth;
+		for (int n : gates)
+			if (nodes[n].is_output)
+				nodes[n].required = target_depth;
+
+		int luts = 0;
+		for (auto it = gates.rbegin(); it != gates.rend(); ++it) {
+			Node &nd = nodes[*it];
+			if (nd.map_refs == 0)
+				continue;
+			luts++;
+			for (int l : nd.cuts.front().leaves) {
+				nodes[l].map_refs++;
+				nodes[l].required = std::min(nodes[l].required, nd.required - 1);
+			}
+		}
+		return luts;
+	}
+
+	std::vector<std::vector<Cut>> save_mapping() const
+	{
+		std::vector<std::vector<Cut>> mapping;
+		for (int n : gates)
+			mapping.push_back(nodes[n].cuts);
+		return mapping;
+	}
+
+	void restore_mapping(std::vector<std::vector<Cut>> &mapping)
+	{
+		for (int i = 0; i < GetSize(gates); i++) {
+			Node &nd = nodes[gates[i]];
+			nd.cuts.swap(mapping[i]);
+			evaluate_cut(nd.cuts.front(), MODE_AREA_FLOW);
+			nd.depth = nd.cuts.front().depth;
+			nd.area_flow = nd.cuts.front().area_flow;
+		}
+		update_mapping();
+	}
+
+	void map_luts(bool area)
+	{
+		for (int n : gates)
+			enumerate_cuts(n, MODE_DEPTH);
+		int luts = update_mapping();
+		log("Depth-oriented mapping: %d LUTs, depth %d.\n", luts, depth);
+
+		if (!area)
+			return;
+
+		for (Mode mode : {MODE_AREA_FLOW, MODE_EXACT_AREA}) {
+			auto mapping = save_mapping();
+			if (mode == MODE_AREA_FLOW)
+				for (int n : gates)
+					enumerate_cuts(n, mode);
+			else
+				exact_area_pass();
+			int new_luts = update_mapping();
+			if (depth > target_depth || new_luts > luts) {
+				restore_mapping(mapping);
+				log("%s recovery did not improve the mapping.\n", mode == MODE_AREA_FLOW ? "Area flow" : "Exact area");
+				continue;
+			}
+			luts = new_luts;
+			log("%s recovery: %d LUTs, depth %d.\n", mode == MODE_AREA_FLOW ? "Area flow" : "Exact area", luts, depth);
+		}
+	}
+
+	uint64_t simulate(int n, dict<int, uint64_t> &values, pool<std::string> &srcs)
+	{
+		auto it = values.find(n);
+		if (it != values.end())
+			return it->second;
+		uint64_t value;
+		if (is_const(n)) {
+			value = nodes[n].bit.data == State::S1 ? ~uint64_t(0) : 0;
+		} else {
+			log_assert(is_gate(n));
+			Node &nd = nodes[n];
+			uint64_t in[3];
+			for (int i = 0; i < GetSize(nd.fanins); i++)
+				in[i] = simulate(nd.fanins[i], values, srcs);
+			value = eval_gate(nd.cell->type, in);
+			for (auto &src : nd.cell->get_strpool_attribute(ID::src))
+				srcs.insert(src);
+		}
+		values[n] = value;
+		return value;
+	}
+
+	void pack_luts()
+	{
+		static const uint64_t var_masks[6] = {
+			0xaaaaaaaaaaaaaaaaULL, 0xccccccccccccccccULL, 0xf0f0f0f0f0f0f0f0ULL,
+			0xff00ff00ff00ff00ULL, 0xffff0000ffff0000ULL, 0xffffffff00000000ULL,
+		};
+
+		for (int n : gates) {
+			Node &nd = nodes[n];
+			if (nd.map_refs == 0)
+				continue;
+
+			auto &leaves = nd.cuts.front().leaves;
+			dict<int, uint64_t> values;
+			pool<std::string> srcs;
+			for (int i = 0; i < GetSize(leaves); i++)
+				values[leaves[i]] = var_masks[i];
+			uint64_t value = simulate(n, values, srcs);
+
+			RTLIL::SigBit y = nd.cell->getPort(ID::Y)[0];
+			if (leaves.empty()) {
+				module->connect(y, value & 1 ? State::S1 : State::S0);
+				continue;
+			}
+
+			RTLIL::SigSpec lut_a;
+			for (int l : leaves)
+				lut_a.append(nodes[l].bit);
+			RTLIL::Const lut_table(State::S0, 1 << GetSize(leaves));
+			for (int i = 0; i < GetSize(lut_table); i++)
+				if ((value >> i) & 1)
+					lut_table[i] = State::S1;
+
+			RTLIL::Cell *lut = module->addLut(NEW_ID, lut_a, y, lut_table);
+			lut->add_strpool_attribute(ID::src, srcs);
+			lut_count++;
+		}
+
+		for (int n : gates)
+			module->remove(nodes[n].cell);
+	}
+
+	CutmapWorker(RTLIL::Module *module, int lut_size, int max_cuts, bool area) :
+			module(module), sigmap(module), lut_size(lut_size), max_cuts(max_cuts)
+	{
+		discover_nodes();
+		if (gates.empty())
+			return;
+		map_luts(area);
+		pack_luts();
+		log("Mapped %d gates in module %s to %d LUTs with maximum depth %d.\n", gate_count, log_id(module), lut_count, depth);
+	}
+};
+
+struct CutmapPass : public Pass {
+	CutmapPass() : Pass("cutmap", "pack LUTs with priority cut enumeration") { }
+	void help() override
+	{
+		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
+		log("\n");
+		log("    cutmap [options] [selection]\n");
+		log("\n");
+		log("This pass maps fine-grained logic gates to k-LUTs using priority cut enumeration.\n");
+		log("A depth-optimal mapping is computed first, and its LUT count is then reduced with\n");
+		log("area flow and exact area recovery without increasing the depth. It is intended\n");
+		log("for the $_AND_/$_NOT_ graphs created by the `aigmap' pass, but also maps $_BUF_,\n");
+		log("$_NAND_, $_OR_, $_NOR_, $_XOR_, $_XNOR_, $_ANDNOT_, $_ORNOT_, $_MUX_ and $_NMUX_.\n");
+		log("Cells with the keep attribute are left alone.\n");
+		log("\n");
+		log("    -maxlut k\n");
+		log("        perform technology mapping for a k-LUT architecture (2 <= k <= 6).\n");
+		log("        if not specified, defaults to 4.\n");
+		log("\n");
+		log("    -cuts n\n");
+		log("        number of priority cuts kept for every gate. if not specified,\n");
+		log("        defaults to 20.\n");
+		log("\n");
+		log("    -noarea\n");
+		log("        only compute the depth-optimal mapping, without area recovery.\n");
+		log("\n");
+	}
+	void execute(std::vector<std::string> args, RTLIL::Design *design) override
+	{
+		int lut_size = 4;
+		int max_cuts = 20;
+		bool area = true;
+
+		size_t argidx;
+		for (argidx = 1; argidx < args.size(); argidx++)
+		{
+			if (args[argidx] == "-maxlut" && argidx + 1 < args.size()) {
+				lut_size = atoi(args[++argidx].c_str());
+				continue;
+			}
+			if (args[argidx] == "-cuts" && argidx + 1 < args.size()) {
+				max_cuts = atoi(args[++argidx].c_str());
+				continue;
+			}
+			if (args[argidx] == "-noarea") {
+				area = false;
+				continue;
+			}
+			break;
+		}
+		extra_args(args, argidx, design);
+
+		if (lut_size < 2 || lut_size > 6)
+			log_cmd_error("LUT size must be between 2 and 6.\n");
+		if (max_cuts < 1)
+			log_cmd_error("Number of priority cuts must be at least 1.\n");
+
+		log_header(design, "Executing CUTMAP pass (pack LUTs with priority cuts).\n");
+
+		int gate_count = 0, lut_count = 0;
+		for (auto module : design->selected_modules())
+		{
+			if (module->has_processes_warn())
+				continue;
+			CutmapWorker worker(module, lut_size, max_cuts, area);
+			gate_count += worker.gate_count;
+			lut_count += worker.lut_count;
+		}
+
+		log("\n");
+		log("Packed %d gates into %d LUTs.\n", gate_count, lut_count);
+	}
+} CutmapPass;
+
+PRIVATE_NAMESPACE_END
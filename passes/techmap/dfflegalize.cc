@@ -61,6 +61,12 @@ enum FfInit {
 	INIT_1 = 0x4,
 };
 
+struct FfTypeInfo {
+	FfType type;
+	int neg;
+	bool has_srst;
+};
+
 struct DffLegalizePass : public Pass {
 	DffLegalizePass() : Pass("dfflegalize", "convert FFs to types supported by the target") { }
 	void help() override
@@ -164,6 +170,14 @@ struct DffLegalizePass : public Pass {
 	// Aggregated for all *dlatch* cells.
 	int supported_dlatch;
 
+	// The set of inputs to invert (OR of NEG_* values) to make a cell
+	// of the given type, polarity and init value (INIT_* value) supported,
+	// or -1 if no polarity of that cell type supports the init value.
+	int polarity_fix[NUM_FFTYPES][NUM_NEG][INIT_1 + 1];
+
+	// Decoded fine-grained FF cell types.
+	dict<IdString, FfTypeInfo> ff_type_info;
+
 	int mince;
 	int minsrst;
 
@@ -173,6 +187,20 @@ struct DffLegalizePass : public Pass {
 	SigMap sigmap;
 	FfInitVals initvals;
 
+	// Inverted signals already created in the current module, shared
+	// between all FFs that need the same signal inverted.
+	dict<SigBit, SigBit> inverted;
+
+	SigBit invert(Module *module, SigBit bit) {
+		SigBit key = sigmap(bit);
+		auto it = inverted.find(key);
+		if (it != inverted.end())
+			return it->second;
+		SigBit result = module->NotGate(NEW_ID, bit);
+		inverted[key] = result;
+		return result;
+	}
+
 	int flip_initmask(int mask) {
 		int res = mask & INIT_X;
 		if (mask & INIT_0)
@@ -182,32 +210,15 @@ struct DffLegalizePass : public Pass {
 		return res;
 	}
 
-	void handle_ff(Cell *cell) {
-		std::string type_str = cell->type.str();
-
-		FfType ff_type;
-		int ff_neg = 0;
-		SigSpec sig_d;
-		SigSpec sig_q;
-		SigSpec sig_c;
-		SigSpec sig_e;
-		SigSpec sig_r;
-		SigSpec sig_s;
-		bool has_srst = false;
+	// Decodes a fine-grained FF cell type name.  Done once per cell type
+	// (see ff_type_info) rather than once per cell.
+	static bool parse_ff_type(const std::string &type_str, FfTypeInfo &info) {
+		FfType &ff_type = info.type;
+		int &ff_neg = info.neg;
+		bool &has_srst = info.has_srst;
+		ff_neg = 0;
+		has_srst = false;
 
-		if (cell->hasPort(ID::D))
-			sig_d = cell->getPort(ID::D);
-		if (cell->hasPort(ID::Q))
-			sig_q = cell->getPort(ID::Q);
-		if (cell->hasPort(ID::C))
-			sig_c = cell->getPort(ID::C);
-		if (cell->hasPort(ID::E))
-			sig_e = cell->getPort(ID::E);
-		if (cell->hasPort(ID::R))
-			sig_r = cell->getPort(ID::R);
-		if (cell->hasPort(ID::S))
-			sig_s = cell->getPort(ID::S);
-		
 		if (type_str.substr(0, 5) == "$_SR_") {
 			ff_type = FF_SR;
 			if (type_str[5] == 'N')
@@ -300,9 +311,40 @@ struct DffLegalizePass : public Pass {
 			if (type_str[13] == 'N')
 				ff_neg |= NEG_R;
 		} else {
+			return false;
+		}
+		return true;
+	}
+
+	void handle_ff(Cell *cell) {
+		SigSpec sig_d;
+		SigSpec sig_q;
+		SigSpec sig_c;
+		SigSpec sig_e;
+		SigSpec sig_r;
+		SigSpec sig_s;
+
+		if (cell->hasPort(ID::D))
+			sig_d = cell->getPort(ID::D);
+		if (cell->hasPort(ID::Q))
+			sig_q = cell->getPort(ID::Q);
+		if (cell->hasPort(ID::C))
+			sig_c = cell->getPort(ID::C);
+		if (cell->hasPort(ID::E))
+			sig_e = cell->getPort(ID::E);
+		if (cell->hasPort(ID::R))
+			sig_r = cell->getPort(ID::R);
+		if (cell->hasPort(ID::S))
+			sig_s = cell->getPort(ID::S);
+		
+		auto it = ff_type_info.find(cell->type);
+		if (it == ff_type_info.end()) {
 			log_warning("Ignoring unknown ff type %s [%s.%s].\n", log_id(cell->type), log_id(cell->module->name), log_id(cell->name));
 			return;
 		}
+		FfType ff_type = it->second.type;
+		int ff_neg = it->second.neg;
+		bool has_srst = it->second.has_srst;
 
 		State initval = initvals(sig_q[0]);
 		
@@ -337,7 +379,7 @@ flip_dqi:
 							initmask = INIT_0;
 						}
 						if (ff_type != FF_SR)
-							sig_d = cell->module->NotGate(NEW_ID, sig_d[0]);
+							sig_d = invert(cell->module, sig_d[0]);
 						SigBit new_q = SigSpec(cell->module->addWire(NEW_ID))[0];
 						cell->module->addNotGate(NEW_ID, new_q, sig_q[0]);
 						initvals.remove_init(sig_q[0]);
@@ -913,22 +955,16 @@ cell_ok:
 			// Cell is supported, but not with those polarities.
 			// Will need to add some inverters.
 
-			// Find the smallest value that xored with the neg mask
-			// results in a supported one — this results in preferentially
-			// inverting resets before clocks, etc.
-			int xneg;
-			for (xneg = 0; xneg < NUM_NEG; xneg++)
-				if (supported_cells_neg[ff_type][ff_neg ^ xneg] & initmask)
-					break;
-			log_assert(xneg < NUM_NEG);
+			int xneg = polarity_fix[ff_type][ff_neg][initmask];
+			log_assert(xneg >= 0);
 			if (xneg & NEG_R)
-				sig_r = cell->module->NotGate(NEW_ID, sig_r[0]);
+				sig_r = invert(cell->module, sig_r[0]);
 			if (xneg & NEG_S)
-				sig_s = cell->module->NotGate(NEW_ID, sig_s[0]);
+				sig_s = invert(cell->module, sig_s[0]);
 			if (xneg & NEG_E)
-				sig_e = cell->module->NotGate(NEW_ID, sig_e[0]);
+				sig_e = invert(cell->module, sig_e[0]);
 			if (xneg & NEG_C)
-				sig_c = cell->module->NotGate(NEW_ID, sig_c[0]);
+				sig_c = invert(cell->module, sig_c[0]);
 			ff_neg ^= xneg;
 		}
 
@@ -1268,10 +1304,31 @@ unrecognized:
 		supported_sr = supported_dffsr | supported_cells[FF_DLATCHSR] | supported_cells[FF_SR] | supported_cells[FF_ADLATCH0] | flip_initmask(supported_cells[FF_ADLATCH1]);
 		supported_dlatch = supported_cells[FF_DLATCH] | supported_cells[FF_ADLATCH0] | supported_cells[FF_ADLATCH1] | supported_cells[FF_DLATCHSR];
 
+		// Find the smallest value that xored with the neg mask
+		// results in a supported one — this results in preferentially
+		// inverting resets before clocks, etc.
+		for (int i = 0; i < NUM_FFTYPES; i++)
+		for (int neg = 0; neg < NUM_NEG; neg++)
+		for (int initmask : {INIT_X, INIT_0, INIT_1}) {
+			int xneg;
+			for (xneg = 0; xneg < NUM_NEG; xneg++)
+				if (supported_cells_neg[i][neg ^ xneg] & initmask)
+					break;
+			polarity_fix[i][neg][initmask] = xneg < NUM_NEG ? xneg : -1;
+		}
+
+		ff_type_info.clear();
+		for (auto type : RTLIL::builtin_ff_cell_types()) {
+			FfTypeInfo info;
+			if (parse_ff_type(type.str(), info))
+				ff_type_info[type] = info;
+		}
+
 		for (auto module : design->selected_modules())
 		{
 			sigmap.set(module);
 			initvals.set(&sigmap, module);
+			inverted.clear();
 
 			if (mince || minsrst) {
 				ce_used.clear();
@@ -1317,6 +1374,8 @@ unrecognized:
 		initvals.clear();
 		ce_used.clear();
 		srst_used.clear();
+		inverted.clear();
+		ff_type_info.clear();
 	}
 } DffLegalizePass;
 
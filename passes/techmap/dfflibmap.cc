@@ -484,33 +484,28 @@ struct DfflibmapPass : public Pass {
 		if (liberty_file.empty())
 			log_cmd_error("Missing `-liberty liberty_file' option!\n");
 
-		std::ifstream f;
-		f.open(liberty_file.c_str());
-		if (f.fail())
-			log_cmd_error("Can't open liberty file `%s': %s\n", liberty_file.c_str(), strerror(errno));
-		LibertyParser libparser(f);
-		f.close();
-
-		find_cell(libparser.ast, ID($_DFF_N_), false, false, false, false);
-		find_cell(libparser.ast, ID($_DFF_P_), true, false, false, false);
-
-		find_cell(libparser.ast, ID($_DFF_NN0_), false, true, false, false);
-		find_cell(libparser.ast, ID($_DFF_NN1_), false, true, false, true);
-		find_cell(libparser.ast, ID($_DFF_NP0_), false, true, true, false);
-		find_cell(libparser.ast, ID($_DFF_NP1_), false, true, true, true);
-		find_cell(libparser.ast, ID($_DFF_PN0_), true, true, false, false);
-		find_cell(libparser.ast, ID($_DFF_PN1_), true, true, false, true);
-		find_cell(libparser.ast, ID($_DFF_PP0_), true, true, true, false);
-		find_cell(libparser.ast, ID($_DFF_PP1_), true, true, true, true);
-
-		find_cell_sr(libparser.ast, ID($_DFFSR_NNN_), false, false, false);
-		find_cell_sr(libparser.ast, ID($_DFFSR_NNP_), false, false, true);
-		find_cell_sr(libparser.ast, ID($_DFFSR_NPN_), false, true, false);
-		find_cell_sr(libparser.ast, ID($_DFFSR_NPP_), false, true, true);
-		find_cell_sr(libparser.ast, ID($_DFFSR_PNN_), true, false, false);
-		find_cell_sr(libparser.ast, ID($_DFFSR_PNP_), true, false, true);
-		find_cell_sr(libparser.ast, ID($_DFFSR_PPN_), true, true, false);
-		find_cell_sr(libparser.ast, ID($_DFFSR_PPP_), true, true, true);
+		std::shared_ptr<LibertyAst> library = LibertyParser::load_cached(liberty_file);
+
+		find_cell(library.get(), ID($_DFF_N_), false, false, false, false);
+		find_cell(library.get(), ID($_DFF_P_), true, false, false, false);
+
+		find_cell(library.get(), ID($_DFF_NN0_), false, true, false, false);
+		find_cell(library.get(), ID($_DFF_NN1_), false, true, false, true);
+		find_cell(library.get(), ID($_DFF_NP0_), false, true, true, false);
+		find_cell(library.get(), ID($_DFF_NP1_), false, true, true, true);
+		find_cell(library.get(), ID($_DFF_PN0_), true, true, false, false);
+		find_cell(library.get(), ID($_DFF_PN1_), true, true, false, true);
+		find_cell(library.get(), ID($_DFF_PP0_), true, true, true, false);
+		find_cell(library.get(), ID($_DFF_PP1_), true, true, true, true);
+
+		find_cell_sr(library.get(), ID($_DFFSR_NNN_), false, false, false);
+		find_cell_sr(library.get(), ID($_DFFSR_NNP_), false, false, true);
+		find_cell_sr(library.get(), ID($_DFFSR_NPN_), false, true, false);
+		find_cell_sr(library.get(), ID($_DFFSR_NPP_), false, true, true);
+		find_cell_sr(library.get(), ID($_DFFSR_PNN_), true, false, false);
+		find_cell_sr(library.get(), ID($_DFFSR_PNP_), true, false, true);
+		find_cell_sr(library.get(), ID($_DFFSR_PPN_), true, true, false);
+		find_cell_sr(library.get(), ID($_DFFSR_PPP_), true, true, true);
 
 		log("  final dff cell mappings:\n");
 		logmap_all();
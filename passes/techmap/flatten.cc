@@ -28,22 +28,17 @@
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
 
-IdString concat_name(RTLIL::Cell *cell, IdString object_name)
+// Flattened objects are named "<cell>.<name>" for public and "$flatten<cell>.<name>" for private names. This
+// returns the part that depends on the object.
+void split_name(IdString object_name, bool &is_public, std::string &suffix)
 {
-	if (object_name[0] == '\\')
-		return stringf("%s.%s", cell->name.c_str(), object_name.c_str() + 1);
-	else {
-		std::string object_name_str = object_name.str();
-		if (object_name_str.substr(0, 8) == "$flatten")
-			object_name_str.erase(0, 8);
-		return stringf("$flatten%s.%s", cell->name.c_str(), object_name_str.c_str());
-	}
-}
-
-template<class T>
-IdString map_name(RTLIL::Cell *cell, T *object)
-{
-	return cell->module->uniquify(concat_name(cell, object->name));
+	is_public = object_name[0] == '\\';
+	if (is_public)
+		suffix = "." + object_name.str().substr(1);
+	else if (object_name.begins_with("$flatten"))
+		suffix = "." + object_name.str().substr(8);
+	else
+		suffix = "." + object_name.str();
 }
 
 template<class T>
@@ -73,31 +68,99 @@ void map_sigspec(const dict<RTLIL::Wire*, RTLIL::Wire*> &map, RTLIL::SigSpec &si
 	sig = chunks;
 }
 
+// The parts of flattening an instance that only depend on the instantiated module.
+struct FlattenTemplate
+{
+	template<class T>
+	struct Object {
+		T *object;
+		bool is_public;
+		std::string suffix;
+
+		Object(T *object) : object(object) { split_name(object->name, is_public, suffix); }
+	};
+
+	std::vector<Object<RTLIL::Memory>> memories;
+	std::vector<Object<RTLIL::Wire>> wires;
+	std::vector<Object<RTLIL::Process>> processes;
+	std::vector<Object<RTLIL::Cell>> cells;
+	dict<IdString, IdString> positional_ports;
+	pool<SigBit> driven;
+
+	FlattenTemplate(RTLIL::Module *tpl)
+	{
+		for (auto &it : tpl->memories)
+			memories.emplace_back(it.second);
+		for (auto tpl_wire : tpl->wires()) {
+			wires.emplace_back(tpl_wire);
+			if (tpl_wire->port_id > 0)
+				positional_ports.emplace(stringf("$%d", tpl_wire->port_id), tpl_wire->name);
+		}
+		for (auto &it : tpl->processes)
+			processes.emplace_back(it.second);
+		for (auto tpl_cell : tpl->cells()) {
+			cells.emplace_back(tpl_cell);
+			for (auto &tpl_conn : tpl_cell->connections())
+				if (tpl_cell->output(tpl_conn.first))
+					for (auto bit : tpl_conn.second)
+						driven.insert(bit);
+		}
+		for (auto &tpl_conn : tpl->connections())
+			for (auto bit : tpl_conn.first)
+				driven.insert(bit);
+	}
+};
+
 struct FlattenWorker
 {
 	bool ignore_wb = false;
+	bool compact_names = false;
+
+	// Dropped for a module when it is flattened itself, as with a partial selection a module can be used as a
+	// template before it is flattened.
+	dict<RTLIL::Module*, std::unique_ptr<FlattenTemplate>> templates;
+
+	const FlattenTemplate &get_template(RTLIL::Module *tpl)
+	{
+		auto &plan = templates[tpl];
+		if (plan == nullptr)
+			plan.reset(new FlattenTemplate(tpl));
+		return *plan;
+	}
 
-	void flatten_cell(RTLIL::Design *design, RTLIL::Module *module, RTLIL::Cell *cell, RTLIL::Module *tpl, std::vector<RTLIL::Cell*> &new_cells)
+	void flatten_cell(RTLIL::Design *design, RTLIL::Module *module, RTLIL::Cell *cell, RTLIL::Module *tpl, SigMap &sigmap, std::vector<RTLIL::Cell*> &new_cells)
 	{
+		const FlattenTemplate &plan = get_template(tpl);
+		std::string public_prefix = cell->name.str();
+		std::string private_prefix = "$flatten" + public_prefix;
+		if (compact_names) {
+			private_prefix = stringf("$flatten$%d", autoidx++);
+			log_debug("Using scope %s for private objects of %s.%s.\n", private_prefix.c_str(), log_id(module), log_id(cell));
+		}
+
+		auto object_name = [&](bool is_public, const std::string &suffix) {
+			return (is_public ? public_prefix : private_prefix) + suffix;
+		};
+
 		// Copy the contents of the flattened cell
 
 		dict<IdString, IdString> memory_map;
-		for (auto &tpl_memory_it : tpl->memories) {
-			RTLIL::Memory *new_memory = module->addMemory(map_name(cell, tpl_memory_it.second), tpl_memory_it.second);
-			map_attributes(cell, new_memory, tpl_memory_it.second->name);
-			memory_map[tpl_memory_it.first] = new_memory->name;
+		for (auto &tpl_memory : plan.memories) {
+			IdString name = module->uniquify(object_name(tpl_memory.is_public, tpl_memory.suffix));
+			RTLIL::Memory *new_memory = module->addMemory(name, tpl_memory.object);
+			map_attributes(cell, new_memory, tpl_memory.object->name);
+			memory_map[tpl_memory.object->name] = new_memory->name;
 			design->select(module, new_memory);
 		}
 
 		dict<RTLIL::Wire*, RTLIL::Wire*> wire_map;
-		dict<IdString, IdString> positional_ports;
-		for (auto tpl_wire : tpl->wires()) {
-			if (tpl_wire->port_id > 0)
-				positional_ports.emplace(stringf("$%d", tpl_wire->port_id), tpl_wire->name);
+		for (auto &tpl_wire_it : plan.wires) {
+			RTLIL::Wire *tpl_wire = tpl_wire_it.object;
+			IdString name = object_name(tpl_wire_it.is_public, tpl_wire_it.suffix);
 
 			RTLIL::Wire *new_wire = nullptr;
-			if (tpl_wire->name[0] == '\\') {
-				RTLIL::Wire *hier_wire = module->wire(concat_name(cell, tpl_wire->name));
+			if (tpl_wire_it.is_public) {
+				RTLIL::Wire *hier_wire = module->wire(name);
 				if (hier_wire != nullptr && hier_wire->get_bool_attribute(ID::hierconn)) {
 					hier_wire->attributes.erase(ID::hierconn);
 					if (GetSize(hier_wire) < GetSize(tpl_wire)) {
@@ -109,7 +172,7 @@ struct FlattenWorker
 				}
 			}
 			if (new_wire == nullptr) {
-				new_wire = module->addWire(map_name(cell, tpl_wire), tpl_wire);
+				new_wire = module->addWire(module->uniquify(name), tpl_wire);
 				new_wire->port_input = new_wire->port_output = false;
 				new_wire->port_id = false;
 			}
@@ -119,25 +182,30 @@ struct FlattenWorker
 			design->select(module, new_wire);
 		}
 
-		for (auto &tpl_proc_it : tpl->processes) {
-			RTLIL::Process *new_proc = module->addProcess(map_name(cell, tpl_proc_it.second), tpl_proc_it.second);
-			map_attributes(cell, new_proc, tpl_proc_it.second->name);
-			auto rewriter = [&](RTLIL::SigSpec &sig) { map_sigspec(wire_map, sig); };
+		auto rewriter = [&](RTLIL::SigSpec &sig) { map_sigspec(wire_map, sig); };
+
+		for (auto &tpl_proc : plan.processes) {
+			IdString name = module->uniquify(object_name(tpl_proc.is_public, tpl_proc.suffix));
+			RTLIL::Process *new_proc = module->addProcess(name, tpl_proc.object);
+			map_attributes(cell, new_proc, tpl_proc.object->name);
 			new_proc->rewrite_sigspecs(rewriter);
 			design->select(module, new_proc);
 		}
 
-		for (auto tpl_cell : tpl->cells()) {
-			RTLIL::Cell *new_cell = module->addCell(map_name(cell, tpl_cell), tpl_cell);
-			map_attributes(cell, new_cell, tpl_cell->name);
+		for (auto &tpl_cell : plan.cells) {
+			IdString name = module->uniquify(object_name(tpl_cell.is_public, tpl_cell.suffix));
+			RTLIL::Cell *new_cell = module->addCell(name, tpl_cell.object);
+			map_attributes(cell, new_cell, tpl_cell.object->name);
 			if (new_cell->type.in(ID($memrd), ID($memwr), ID($meminit))) {
 				IdString memid = new_cell->getParam(ID::MEMID).decode_string();
 				new_cell->setParam(ID::MEMID, Const(memory_map.at(memid).str()));
 			} else if (new_cell->type == ID($mem)) {
 				IdString memid = new_cell->getParam(ID::MEMID).decode_string();
-				new_cell->setParam(ID::MEMID, Const(concat_name(cell, memid).str()));
+				bool is_public;
+				std::string suffix;
+				split_name(memid, is_public, suffix);
+				new_cell->setParam(ID::MEMID, Const(object_name(is_public, suffix)));
 			}
-			auto rewriter = [&](RTLIL::SigSpec &sig) { map_sigspec(wire_map, sig); };
 			new_cell->rewrite_sigspecs(rewriter);
 			design->select(module, new_cell);
 			new_cells.push_back(new_cell);
@@ -148,26 +216,17 @@ struct FlattenWorker
 			map_sigspec(wire_map, new_conn.first);
 			map_sigspec(wire_map, new_conn.second);
 			module->connect(new_conn);
+			sigmap.add(new_conn.first, new_conn.second);
 		}
 
 		// Attach port connections of the flattened cell
 
-		pool<SigBit> tpl_driven;
-		for (auto tpl_cell : tpl->cells())
-			for (auto &tpl_conn : tpl_cell->connections())
-				if (tpl_cell->output(tpl_conn.first))
-					for (auto bit : tpl_conn.second)
-						tpl_driven.insert(bit);
-		for (auto &tpl_conn : tpl->connections())
-			for (auto bit : tpl_conn.first)
-				tpl_driven.insert(bit);
-
-		SigMap sigmap(module);
+		std::vector<RTLIL::SigSig> port_conns;
 		for (auto &port_it : cell->connections())
 		{
 			IdString port_name = port_it.first;
-			if (positional_ports.count(port_name) > 0)
-				port_name = positional_ports.at(port_name);
+			if (plan.positional_ports.count(port_name) > 0)
+				port_name = plan.positional_ports.at(port_name);
 			if (tpl->wire(port_name) == nullptr || tpl->wire(port_name)->port_id == 0) {
 				if (port_name.begins_with("$"))
 					log_error("Can't map port `%s' of cell `%s' to template `%s'!\n",
@@ -189,7 +248,7 @@ struct FlattenWorker
 			} else {
 				SigSpec sig_tpl = tpl_wire, sig_mod = port_it.second;
 				for (int i = 0; i < GetSize(sig_tpl) && i < GetSize(sig_mod); i++) {
-					if (tpl_driven.count(sig_tpl[i])) {
+					if (plan.driven.count(sig_tpl[i])) {
 						new_conn.first.append(sig_mod[i]);
 						new_conn.second.append(sig_tpl[i]);
 					} else {
@@ -212,8 +271,12 @@ struct FlattenWorker
 					log_id(module), log_id(cell), log_id(port_it.first), log_signal(new_conn.first), log_signal(new_conn.second));
 
 			module->connect(new_conn);
+			port_conns.push_back(new_conn);
 		}
 
+		for (auto &conn : port_conns)
+			sigmap.add(conn.first, conn.second);
+
 		module->remove(cell);
 	}
 
@@ -222,6 +285,9 @@ struct FlattenWorker
 		if (!design->selected(module) || module->get_blackbox_attribute(ignore_wb))
 			return;
 
+		// Kept up to date with the connections added while flattening, instead of being rebuilt for every cell.
+		SigMap sigmap(module);
+
 		std::vector<RTLIL::Cell*> worklist = module->selected_cells();
 		while (!worklist.empty())
 		{
@@ -245,7 +311,8 @@ struct FlattenWorker
 			// If a design is fully selected and has a top module defined, topological sorting ensures that all cells
 			// added during flattening are black boxes, and flattening is finished in one pass. However, when flattening
 			// individual modules, this isn't the case, and the newly added cells might have to be flattened further.
-			flatten_cell(design, module, cell, tpl, worklist);
+			flatten_cell(design, module, cell, tpl, sigmap, worklist);
+			templates.erase(module);
 		}
 	}
 };
@@ -268,6 +335,16 @@ struct FlattenPass : public Pass {
 		log("    -wb\n");
 		log("        Ignore the 'whitebox' attribute on cell implementations.\n");
 		log("\n");
+		log("    -compactnames\n");
+		log("        Objects with private names (such as the $-prefixed wires and cells\n");
+		log("        created by other passes) are normally renamed to include the full\n");
+		log("        hierarchical name of the flattened instance. With this option they\n");
+		log("        are named $flatten$<n>.<name> instead, where <n> is a number unique to\n");
+		log("        the instance. This keeps the names of deeply nested private objects\n");
+		log("        short, which saves a considerable amount of memory on large designs.\n");
+		log("        The names of public objects and their 'hdlname' attributes are not\n");
+		log("        affected. The instance for each <n> is listed in the debug log.\n");
+		log("\n");
 	}
 	void execute(std::vector<std::string> args, RTLIL::Design *design) override
 	{
@@ -282,6 +359,10 @@ struct FlattenPass : public Pass {
 				worker.ignore_wb = true;
 				continue;
 			}
+			if (args[argidx] == "-compactnames") {
+				worker.compact_names = true;
+				continue;
+			}
 			break;
 		}
 		extra_args(args, argidx, design);
@@ -28,6 +28,8 @@
 
 #ifndef FILTERLIB
 #include "kernel/log.h"
+#include "kernel/hashlib.h"
+#include <sys/stat.h>
 #endif
 
 using namespace Yosys;
@@ -182,6 +184,50 @@ int LibertyParser::lexer(std::string &str)
 	return c;
 }
 
+// Groups that only hold lookup tables for timing and power analysis, which make up most of a typical library.
+static bool is_table_group(const std::string &id)
+{
+	static const std::set<std::string> table_groups = {
+		"timing", "internal_power", "receiver_capacitance", "output_current_rise", "output_current_fall",
+		"ccsn_first_stage", "ccsn_last_stage", "dynamic_current", "leakage_current", "intrinsic_parasitic",
+	};
+	return table_groups.count(id) != 0;
+}
+
+// Consumes the contents of a group up to and including its closing '}'.
+void LibertyParser::skip_group()
+{
+	std::streambuf *buf = f.rdbuf();
+	int depth = 1;
+	while (depth > 0)
+	{
+		int c = buf->sbumpc();
+		if (c == EOF)
+			error("Unexpected end of file.");
+		if (c == '\n')
+			line++;
+		else if (c == '{')
+			depth++;
+		else if (c == '}')
+			depth--;
+		else if (c == '"') {
+			while ((c = buf->sbumpc()) != '"' && c != EOF)
+				if (c == '\n')
+					line++;
+		} else if (c == '/' && buf->sgetc() == '*') {
+			int last_c = buf->sbumpc();
+			while ((c = buf->sbumpc()) != EOF && (last_c != '*' || c != '/')) {
+				if (c == '\n')
+					line++;
+				last_c = c;
+			}
+		} else if (c == '/' && buf->sgetc() == '/') {
+			while ((c = buf->sbumpc()) != EOF && c != '\n') { }
+			line++;
+		}
+	}
+}
+
 LibertyAst *LibertyParser::parse()
 {
 	std::string str;
@@ -337,10 +383,18 @@ LibertyAst *LibertyParser::parse()
 		}
 
 		if (tok == '{') {
+			if (skip_tables && is_table_group(ast->id)) {
+				skip_group();
+				break;
+			}
 			while (1) {
 				LibertyAst *child = parse();
 				if (child == NULL)
 					break;
+				if (skip_tables && is_table_group(child->id)) {
+					delete child;
+					continue;
+				}
 				ast->children.push_back(child);
 			}
 			break;
@@ -367,6 +421,36 @@ void LibertyParser::error(const std::string &str)
 	log_error("%s", ss.str().c_str());
 }
 
+std::shared_ptr<LibertyAst> LibertyParser::load_cached(const std::string &filename)
+{
+	struct CacheEntry {
+		long long size, mtime;
+		std::shared_ptr<LibertyAst> ast;
+	};
+	static dict<std::string, CacheEntry> cache;
+
+	struct stat stbuf;
+	if (stat(filename.c_str(), &stbuf) != 0)
+		log_cmd_error("Can't open liberty file `%s': %s\n", filename.c_str(), strerror(errno));
+
+	auto it = cache.find(filename);
+	if (it != cache.end() && it->second.size == stbuf.st_size && it->second.mtime == stbuf.st_mtime) {
+		log("Using cached liberty file `%s'.\n", filename.c_str());
+		return it->second.ast;
+	}
+
+	std::ifstream f;
+	f.open(filename.c_str());
+	if (f.fail())
+		log_cmd_error("Can't open liberty file `%s': %s\n", filename.c_str(), strerror(errno));
+	LibertyParser parser(f, true);
+	std::shared_ptr<LibertyAst> ast(parser.ast);
+	parser.ast = nullptr;
+
+	cache[filename] = CacheEntry{(long long)stbuf.st_size, (long long)stbuf.st_mtime, ast};
+	return ast;
+}
+
 #else
 
 void LibertyParser::error()
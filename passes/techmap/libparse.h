@@ -24,6 +24,7 @@
 #include <string>
 #include <vector>
 #include <set>
+#include <memory>
 
 namespace Yosys
 {
@@ -43,8 +44,10 @@ namespace Yosys
 	{
 		std::istream &f;
 		int line;
+		// Skip the contents of groups that only hold timing and power tables, without creating nodes for them.
+		bool skip_tables;
 		LibertyAst *ast;
-		LibertyParser(std::istream &f) : f(f), line(1), ast(parse()) {}
+		LibertyParser(std::istream &f, bool skip_tables = false) : f(f), line(1), skip_tables(skip_tables), ast(parse()) {}
 		~LibertyParser() { if (ast) delete ast; }
         
         /* lexer return values:
@@ -55,8 +58,15 @@ namespace Yosys
 		int lexer(std::string &str);
 		
         LibertyAst *parse();
+		void skip_group();
 		void error();
         void error(const std::string &str);
+
+#ifndef FILTERLIB
+		// Returns the library in the given file, parsed with skip_tables. Parsed libraries are shared by all
+		// passes, and a file is only parsed again when its size or modification time has changed.
+		static std::shared_ptr<LibertyAst> load_cached(const std::string &filename);
+#endif
 	};
 }
 
@@ -26,8 +26,39 @@
 USING_YOSYS_NAMESPACE
 YOSYS_NAMESPACE_BEGIN
 
+namespace {
+
+// The src attribute given to every gate a cell is mapped to, computed once per
+// cell instead of once per gate.
+struct GateSrc
+{
+	bool valid = false;
+	RTLIL::Const value;
+
+	GateSrc(RTLIL::Cell *cell)
+	{
+		RTLIL::AttrObject attrs;
+		attrs.add_strpool_attribute(ID::src, cell->get_strpool_attribute(ID::src));
+		auto it = attrs.attributes.find(ID::src);
+		if (it != attrs.attributes.end()) {
+			valid = true;
+			value = it->second;
+		}
+	}
+
+	void apply(RTLIL::Cell *gate) const
+	{
+		if (valid)
+			gate->attributes[ID::src] = value;
+	}
+};
+
+}
+
 void simplemap_not(RTLIL::Module *module, RTLIL::Cell *cell)
 {
+	GateSrc src(cell);
+
 	RTLIL::SigSpec sig_a = cell->getPort(ID::A);
 	RTLIL::SigSpec sig_y = cell->getPort(ID::Y);
 
@@ -35,7 +66,7 @@ void simplemap_not(RTLIL::Module *module, RTLIL::Cell *cell)
 
 	for (int i = 0; i < GetSize(sig_y); i++) {
 		RTLIL::Cell *gate = module->addCell(NEW_ID, ID($_NOT_));
-		gate->add_strpool_attribute(ID::src, cell->get_strpool_attribute(ID::src));
+		src.apply(gate);
 		gate->setPort(ID::A, sig_a[i]);
 		gate->setPort(ID::Y, sig_y[i]);
 	}
@@ -53,6 +84,8 @@ void simplemap_pos(RTLIL::Module *module, RTLIL::Cell *cell)
 
 void simplemap_bitop(RTLIL::Module *module, RTLIL::Cell *cell)
 {
+	GateSrc src(cell);
+
 	RTLIL::SigSpec sig_a = cell->getPort(ID::A);
 	RTLIL::SigSpec sig_b = cell->getPort(ID::B);
 	RTLIL::SigSpec sig_y = cell->getPort(ID::Y);
@@ -66,7 +99,7 @@ void simplemap_bitop(RTLIL::Module *module, RTLIL::Cell *cell)
 
 		for (int i = 0; i < GetSize(sig_y); i++) {
 			RTLIL::Cell *gate = module->addCell(NEW_ID, ID($_NOT_));
-			gate->add_strpool_attribute(ID::src, cell->get_strpool_attribute(ID::src));
+			src.apply(gate);
 			gate->setPort(ID::A, sig_t[i]);
 			gate->setPort(ID::Y, sig_y[i]);
 		}
@@ -83,7 +116,7 @@ void simplemap_bitop(RTLIL::Module *module, RTLIL::Cell *cell)
 
 	for (int i = 0; i < GetSize(sig_y); i++) {
 		RTLIL::Cell *gate = module->addCell(NEW_ID, gate_type);
-		gate->add_strpool_attribute(ID::src, cell->get_strpool_attribute(ID::src));
+		src.apply(gate);
 		gate->setPort(ID::A, sig_a[i]);
 		gate->setPort(ID::B, sig_b[i]);
 		gate->setPort(ID::Y, sig_y[i]);
@@ -92,6 +125,8 @@ void simplemap_bitop(RTLIL::Module *module, RTLIL::Cell *cell)
 
 void simplemap_reduce(RTLIL::Module *module, RTLIL::Cell *cell)
 {
+	GateSrc src(cell);
+
 	RTLIL::SigSpec sig_a = cell->getPort(ID::A);
 	RTLIL::SigSpec sig_y = cell->getPort(ID::Y);
 
@@ -134,7 +169,7 @@ void simplemap_reduce(RTLIL::Module *module, RTLIL::Cell *cell)
 			}
 
 			RTLIL::Cell *gate = module->addCell(NEW_ID, gate_type);
-			gate->add_strpool_attribute(ID::src, cell->get_strpool_attribute(ID::src));
+			src.apply(gate);
 			gate->setPort(ID::A, sig_a[i]);
 			gate->setPort(ID::B, sig_a[i+1]);
 			gate->setPort(ID::Y, sig_t[i/2]);
@@ -147,7 +182,7 @@ void simplemap_reduce(RTLIL::Module *module, RTLIL::Cell *cell)
 	if (cell->type == ID($reduce_xnor)) {
 		RTLIL::SigSpec sig_t = module->addWire(NEW_ID);
 		RTLIL::Cell *gate = module->addCell(NEW_ID, ID($_NOT_));
-		gate->add_strpool_attribute(ID::src, cell->get_strpool_attribute(ID::src));
+		src.apply(gate);
 		gate->setPort(ID::A, sig_a);
 		gate->setPort(ID::Y, sig_t);
 		last_output_cell = gate;
@@ -163,6 +198,8 @@ void simplemap_reduce(RTLIL::Module *module, RTLIL::Cell *cell)
 
 static void logic_reduce(RTLIL::Module *module, RTLIL::SigSpec &sig, RTLIL::Cell *cell)
 {
+	GateSrc src(cell);
+
 	while (sig.size() > 1)
 	{
 		RTLIL::SigSpec sig_t = module->addWire(NEW_ID, sig.size() / 2);
@@ -175,7 +212,7 @@ static void logic_reduce(RTLIL::Module *module, RTLIL::SigSpec &sig, RTLIL::Cell
 			}
 
 			RTLIL::Cell *gate = module->addCell(NEW_ID, ID($_OR_));
-			gate->add_strpool_attribute(ID::src, cell->get_strpool_attribute(ID::src));
+			src.apply(gate);
 			gate->setPort(ID::A, sig[i]);
 			gate->setPort(ID::B, sig[i+1]);
 			gate->setPort(ID::Y, sig_t[i/2]);
@@ -190,6 +227,8 @@ static void logic_reduce(RTLIL::Module *module, RTLIL::SigSpec &sig, RTLIL::Cell
 
 void simplemap_lognot(RTLIL::Module *module, RTLIL::Cell *cell)
 {
+	GateSrc src(cell);
+
 	RTLIL::SigSpec sig_a = cell->getPort(ID::A);
 	logic_reduce(module, sig_a, cell);
 
@@ -204,13 +243,15 @@ void simplemap_lognot(RTLIL::Module *module, RTLIL::Cell *cell)
 	}
 
 	RTLIL::Cell *gate = module->addCell(NEW_ID, ID($_NOT_));
-	gate->add_strpool_attribute(ID::src, cell->get_strpool_attribute(ID::src));
+	src.apply(gate);
 	gate->setPort(ID::A, sig_a);
 	gate->setPort(ID::Y, sig_y);
 }
 
 void simplemap_logbin(RTLIL::Module *module, RTLIL::Cell *cell)
 {
+	GateSrc src(cell);
+
 	RTLIL::SigSpec sig_a = cell->getPort(ID::A);
 	logic_reduce(module, sig_a, cell);
 
@@ -233,7 +274,7 @@ void simplemap_logbin(RTLIL::Module *module, RTLIL::Cell *cell)
 	log_assert(!gate_type.empty());
 
 	RTLIL::Cell *gate = module->addCell(NEW_ID, gate_type);
-	gate->add_strpool_attribute(ID::src, cell->get_strpool_attribute(ID::src));
+	src.apply(gate);
 	gate->setPort(ID::A, sig_a);
 	gate->setPort(ID::B, sig_b);
 	gate->setPort(ID::Y, sig_y);
@@ -269,13 +310,15 @@ void simplemap_eqne(RTLIL::Module *module, RTLIL::Cell *cell)
 
 void simplemap_mux(RTLIL::Module *module, RTLIL::Cell *cell)
 {
+	GateSrc src(cell);
+
 	RTLIL::SigSpec sig_a = cell->getPort(ID::A);
 	RTLIL::SigSpec sig_b = cell->getPort(ID::B);
 	RTLIL::SigSpec sig_y = cell->getPort(ID::Y);
 
 	for (int i = 0; i < GetSize(sig_y); i++) {
 		RTLIL::Cell *gate = module->addCell(NEW_ID, ID($_MUX_));
-		gate->add_strpool_attribute(ID::src, cell->get_strpool_attribute(ID::src));
+		src.apply(gate);
 		gate->setPort(ID::A, sig_a[i]);
 		gate->setPort(ID::B, sig_b[i]);
 		gate->setPort(ID::S, cell->getPort(ID::S));
@@ -285,13 +328,15 @@ void simplemap_mux(RTLIL::Module *module, RTLIL::Cell *cell)
 
 void simplemap_tribuf(RTLIL::Module *module, RTLIL::Cell *cell)
 {
+	GateSrc src(cell);
+
 	RTLIL::SigSpec sig_a = cell->getPort(ID::A);
 	RTLIL::SigSpec sig_e = cell->getPort(ID::EN);
 	RTLIL::SigSpec sig_y = cell->getPort(ID::Y);
 
 	for (int i = 0; i < GetSize(sig_y); i++) {
 		RTLIL::Cell *gate = module->addCell(NEW_ID, ID($_TBUF_));
-		gate->add_strpool_attribute(ID::src, cell->get_strpool_attribute(ID::src));
+		src.apply(gate);
 		gate->setPort(ID::A, sig_a[i]);
 		gate->setPort(ID::E, sig_e);
 		gate->setPort(ID::Y, sig_y[i]);
@@ -300,6 +345,8 @@ void simplemap_tribuf(RTLIL::Module *module, RTLIL::Cell *cell)
 
 void simplemap_lut(RTLIL::Module *module, RTLIL::Cell *cell)
 {
+	GateSrc src(cell);
+
 	SigSpec lut_ctrl = cell->getPort(ID::A);
 	SigSpec lut_data = cell->getParam(ID::LUT);
 	lut_data.extend_u0(1 << cell->getParam(ID::WIDTH).as_int());
@@ -309,7 +356,7 @@ void simplemap_lut(RTLIL::Module *module, RTLIL::Cell *cell)
 		SigSpec new_lut_data = module->addWire(NEW_ID, GetSize(lut_data)/2);
 		for (int i = 0; i < GetSize(lut_data); i += 2) {
 			RTLIL::Cell *gate = module->addCell(NEW_ID, ID($_MUX_));
-			gate->add_strpool_attribute(ID::src, cell->get_strpool_attribute(ID::src));
+			src.apply(gate);
 			gate->setPort(ID::A, lut_data[i]);
 			gate->setPort(ID::B, lut_data[i+1]);
 			gate->setPort(ID::S, lut_ctrl[idx]);
@@ -369,6 +416,8 @@ void simplemap_concat(RTLIL::Module *module, RTLIL::Cell *cell)
 
 void simplemap_sr(RTLIL::Module *module, RTLIL::Cell *cell)
 {
+	GateSrc src(cell);
+
 	int width = cell->parameters.at(ID::WIDTH).as_int();
 	char set_pol = cell->parameters.at(ID::SET_POLARITY).as_bool() ? 'P' : 'N';
 	char clr_pol = cell->parameters.at(ID::CLR_POLARITY).as_bool() ? 'P' : 'N';
@@ -381,7 +430,7 @@ void simplemap_sr(RTLIL::Module *module, RTLIL::Cell *cell)
 
 	for (int i = 0; i < width; i++) {
 		RTLIL::Cell *gate = module->addCell(NEW_ID, gate_type);
-		gate->add_strpool_attribute(ID::src, cell->get_strpool_attribute(ID::src));
+		src.apply(gate);
 		gate->setPort(ID::S, sig_s[i]);
 		gate->setPort(ID::R, sig_r[i]);
 		gate->setPort(ID::Q, sig_q[i]);
@@ -390,6 +439,8 @@ void simplemap_sr(RTLIL::Module *module, RTLIL::Cell *cell)
 
 void simplemap_ff(RTLIL::Module *module, RTLIL::Cell *cell)
 {
+	GateSrc src(cell);
+
 	int width = cell->parameters.at(ID::WIDTH).as_int();
 
 	RTLIL::SigSpec sig_d = cell->getPort(ID::D);
@@ -399,7 +450,7 @@ void simplemap_ff(RTLIL::Module *module, RTLIL::Cell *cell)
 
 	for (int i = 0; i < width; i++) {
 		RTLIL::Cell *gate = module->addCell(NEW_ID, gate_type);
-		gate->add_strpool_attribute(ID::src, cell->get_strpool_attribute(ID::src));
+		src.apply(gate);
 		gate->setPort(ID::D, sig_d[i]);
 		gate->setPort(ID::Q, sig_q[i]);
 	}
@@ -407,6 +458,8 @@ void simplemap_ff(RTLIL::Module *module, RTLIL::Cell *cell)
 
 void simplemap_dff(RTLIL::Module *module, RTLIL::Cell *cell)
 {
+	GateSrc src(cell);
+
 	int width = cell->parameters.at(ID::WIDTH).as_int();
 	char clk_pol = cell->parameters.at(ID::CLK_POLARITY).as_bool() ? 'P' : 'N';
 
@@ -418,7 +471,7 @@ void simplemap_dff(RTLIL::Module *module, RTLIL::Cell *cell)
 
 	for (int i = 0; i < width; i++) {
 		RTLIL::Cell *gate = module->addCell(NEW_ID, gate_type);
-		gate->add_strpool_attribute(ID::src, cell->get_strpool_attribute(ID::src));
+		src.apply(gate);
 		gate->setPort(ID::C, sig_clk);
 		gate->setPort(ID::D, sig_d[i]);
 		gate->setPort(ID::Q, sig_q[i]);
@@ -427,6 +480,8 @@ void simplemap_dff(RTLIL::Module *module, RTLIL::Cell *cell)
 
 void simplemap_dffe(RTLIL::Module *module, RTLIL::Cell *cell)
 {
+	GateSrc src(cell);
+
 	int width = cell->parameters.at(ID::WIDTH).as_int();
 	char clk_pol = cell->parameters.at(ID::CLK_POLARITY).as_bool() ? 'P' : 'N';
 	char en_pol = cell->parameters.at(ID::EN_POLARITY).as_bool() ? 'P' : 'N';
@@ -440,7 +495,7 @@ void simplemap_dffe(RTLIL::Module *module, RTLIL::Cell *cell)
 
 	for (int i = 0; i < width; i++) {
 		RTLIL::Cell *gate = module->addCell(NEW_ID, gate_type);
-		gate->add_strpool_attribute(ID::src, cell->get_strpool_attribute(ID::src));
+		src.apply(gate);
 		gate->setPort(ID::C, sig_clk);
 		gate->setPort(ID::E, sig_en);
 		gate->setPort(ID::D, sig_d[i]);
@@ -450,6 +505,8 @@ void simplemap_dffe(RTLIL::Module *module, RTLIL::Cell *cell)
 
 void simplemap_dffsr(RTLIL::Module *module, RTLIL::Cell *cell)
 {
+	GateSrc src(cell);
+
 	int width = cell->parameters.at(ID::WIDTH).as_int();
 	char clk_pol = cell->parameters.at(ID::CLK_POLARITY).as_bool() ? 'P' : 'N';
 	char set_pol = cell->parameters.at(ID::SET_POLARITY).as_bool() ? 'P' : 'N';
@@ -465,7 +522,7 @@ void simplemap_dffsr(RTLIL::Module *module, RTLIL::Cell *cell)
 
 	for (int i = 0; i < width; i++) {
 		RTLIL::Cell *gate = module->addCell(NEW_ID, gate_type);
-		gate->add_strpool_attribute(ID::src, cell->get_strpool_attribute(ID::src));
+		src.apply(gate);
 		gate->setPort(ID::C, sig_clk);
 		gate->setPort(ID::S, sig_s[i]);
 		gate->setPort(ID::R, sig_r[i]);
@@ -476,6 +533,8 @@ void simplemap_dffsr(RTLIL::Module *module, RTLIL::Cell *cell)
 
 void simplemap_dffsre(RTLIL::Module *module, RTLIL::Cell *cell)
 {
+	GateSrc src(cell);
+
 	int width = cell->parameters.at(ID::WIDTH).as_int();
 	char clk_pol = cell->parameters.at(ID::CLK_POLARITY).as_bool() ? 'P' : 'N';
 	char set_pol = cell->parameters.at(ID::SET_POLARITY).as_bool() ? 'P' : 'N';
@@ -493,7 +552,7 @@ void simplemap_dffsre(RTLIL::Module *module, RTLIL::Cell *cell)
 
 	for (int i = 0; i < width; i++) {
 		RTLIL::Cell *gate = module->addCell(NEW_ID, gate_type);
-		gate->add_strpool_attribute(ID::src, cell->get_strpool_attribute(ID::src));
+		src.apply(gate);
 		gate->setPort(ID::C, sig_clk);
 		gate->setPort(ID::S, sig_s[i]);
 		gate->setPort(ID::R, sig_r[i]);
@@ -505,6 +564,8 @@ void simplemap_dffsre(RTLIL::Module *module, RTLIL::Cell *cell)
 
 void simplemap_adff_sdff(RTLIL::Module *module, RTLIL::Cell *cell)
 {
+	GateSrc src(cell);
+
 	int width = cell->parameters.at(ID::WIDTH).as_int();
 	bool is_async = cell->type == ID($adff);
 	char clk_pol = cell->parameters.at(ID::CLK_POLARITY).as_bool() ? 'P' : 'N';
@@ -525,7 +586,7 @@ void simplemap_adff_sdff(RTLIL::Module *module, RTLIL::Cell *cell)
 
 	for (int i = 0; i < width; i++) {
 		RTLIL::Cell *gate = module->addCell(NEW_ID, rst_val.at(i) == RTLIL::State::S1 ? gate_type_1 : gate_type_0);
-		gate->add_strpool_attribute(ID::src, cell->get_strpool_attribute(ID::src));
+		src.apply(gate);
 		gate->setPort(ID::C, sig_clk);
 		gate->setPort(ID::R, sig_rst);
 		gate->setPort(ID::D, sig_d[i]);
@@ -535,6 +596,8 @@ void simplemap_adff_sdff(RTLIL::Module *module, RTLIL::Cell *cell)
 
 void simplemap_adffe_sdffe_sdffce(RTLIL::Module *module, RTLIL::Cell *cell)
 {
+	GateSrc src(cell);
+
 	int width = cell->parameters.at(ID::WIDTH).as_int();
 	bool is_async = cell->type == ID($adffe);
 	char clk_pol = cell->parameters.at(ID::CLK_POLARITY).as_bool() ? 'P' : 'N';
@@ -557,7 +620,7 @@ void simplemap_adffe_sdffe_sdffce(RTLIL::Module *module, RTLIL::Cell *cell)
 
 	for (int i = 0; i < width; i++) {
 		RTLIL::Cell *gate = module->addCell(NEW_ID, rst_val.at(i) == RTLIL::State::S1 ? gate_type_1 : gate_type_0);
-		gate->add_strpool_attribute(ID::src, cell->get_strpool_attribute(ID::src));
+		src.apply(gate);
 		gate->setPort(ID::C, sig_clk);
 		gate->setPort(ID::R, sig_rst);
 		gate->setPort(ID::E, sig_e);
@@ -568,6 +631,8 @@ void simplemap_adffe_sdffe_sdffce(RTLIL::Module *module, RTLIL::Cell *cell)
 
 void simplemap_dlatch(RTLIL::Module *module, RTLIL::Cell *cell)
 {
+	GateSrc src(cell);
+
 	int width = cell->parameters.at(ID::WIDTH).as_int();
 	char en_pol = cell->parameters.at(ID::EN_POLARITY).as_bool() ? 'P' : 'N';
 
@@ -579,7 +644,7 @@ void simplemap_dlatch(RTLIL::Module *module, RTLIL::Cell *cell)
 
 	for (int i = 0; i < width; i++) {
 		RTLIL::Cell *gate = module->addCell(NEW_ID, gate_type);
-		gate->add_strpool_attribute(ID::src, cell->get_strpool_attribute(ID::src));
+		src.apply(gate);
 		gate->setPort(ID::E, sig_en);
 		gate->setPort(ID::D, sig_d[i]);
 		gate->setPort(ID::Q, sig_q[i]);
@@ -588,6 +653,8 @@ void simplemap_dlatch(RTLIL::Module *module, RTLIL::Cell *cell)
 
 void simplemap_adlatch(RTLIL::Module *module, RTLIL::Cell *cell)
 {
+	GateSrc src(cell);
+
 	int width = cell->parameters.at(ID::WIDTH).as_int();
 	char en_pol = cell->parameters.at(ID::EN_POLARITY).as_bool() ? 'P' : 'N';
 	char rst_pol = cell->parameters.at(ID::ARST_POLARITY).as_bool() ? 'P' : 'N';
@@ -606,7 +673,7 @@ void simplemap_adlatch(RTLIL::Module *module, RTLIL::Cell *cell)
 
 	for (int i = 0; i < width; i++) {
 		RTLIL::Cell *gate = module->addCell(NEW_ID, rst_val.at(i) == RTLIL::State::S1 ? gate_type_1 : gate_type_0);
-		gate->add_strpool_attribute(ID::src, cell->get_strpool_attribute(ID::src));
+		src.apply(gate);
 		gate->setPort(ID::E, sig_en);
 		gate->setPort(ID::R, sig_rst);
 		gate->setPort(ID::D, sig_d[i]);
@@ -616,6 +683,8 @@ void simplemap_adlatch(RTLIL::Module *module, RTLIL::Cell *cell)
 
 void simplemap_dlatchsr(RTLIL::Module *module, RTLIL::Cell *cell)
 {
+	GateSrc src(cell);
+
 	int width = cell->parameters.at(ID::WIDTH).as_int();
 	char en_pol = cell->parameters.at(ID::EN_POLARITY).as_bool() ? 'P' : 'N';
 	char set_pol = cell->parameters.at(ID::SET_POLARITY).as_bool() ? 'P' : 'N';
@@ -631,7 +700,7 @@ void simplemap_dlatchsr(RTLIL::Module *module, RTLIL::Cell *cell)
 
 	for (int i = 0; i < width; i++) {
 		RTLIL::Cell *gate = module->addCell(NEW_ID, gate_type);
-		gate->add_strpool_attribute(ID::src, cell->get_strpool_attribute(ID::src));
+		src.apply(gate);
 		gate->setPort(ID::E, sig_en);
 		gate->setPort(ID::S, sig_s[i]);
 		gate->setPort(ID::R, sig_r[i]);
@@ -726,12 +795,22 @@ struct SimplemapPass : public Pass {
 		for (auto mod : design->modules()) {
 			if (!design->selected(mod) || mod->get_blackbox_attribute())
 				continue;
-			std::vector<RTLIL::Cell*> cells = mod->cells();
-			for (auto cell : cells) {
+			std::vector<RTLIL::Cell*> cells;
+			int new_cells = 0;
+			for (auto cell : mod->cells()) {
 				if (mappers.count(cell->type) == 0)
 					continue;
 				if (!design->selected(mod, cell))
 					continue;
+				cells.push_back(cell);
+				for (auto &conn : cell->connections())
+					if (cell->output(conn.first))
+						new_cells += GetSize(conn.second);
+			}
+			// Most cells map to one gate per output bit; reserve room for them
+			// up front so the cell dict is not rehashed over and over.
+			mod->cells_.reserve(GetSize(mod->cells_) + new_cells);
+			for (auto cell : cells) {
 				log("Mapping %s.%s (%s).\n", log_id(mod), log_id(cell), log_id(cell->type));
 				mappers.at(cell->type)(mod, cell);
 				mod->remove(cell);
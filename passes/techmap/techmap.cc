@@ -22,6 +22,7 @@
 #include "kernel/sigtools.h"
 #include "kernel/ffinit.h"
 #include "libs/sha1/sha1.h"
+#include "frontends/verilog/verilog_frontend.h"
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -47,16 +48,12 @@ void apply_prefix(IdString prefix, IdString &id)
 		id = stringf("$techmap%s.%s", prefix.c_str(), id.c_str());
 }
 
-void apply_prefix(IdString prefix, RTLIL::SigSpec &sig, RTLIL::Module *module)
+void apply_wire_map(const dict<RTLIL::Wire*, RTLIL::Wire*> &wire_map, RTLIL::SigSpec &sig)
 {
 	vector<SigChunk> chunks = sig;
 	for (auto &chunk : chunks)
-		if (chunk.wire != nullptr) {
-			IdString wire_name = chunk.wire->name;
-			apply_prefix(prefix, wire_name);
-			log_assert(module->wire(wire_name) != nullptr);
-			chunk.wire = module->wire(wire_name);
-		}
+		if (chunk.wire != nullptr)
+			chunk.wire = wire_map.at(chunk.wire);
 	sig = chunks;
 }
 
@@ -70,6 +67,16 @@ struct TechmapWorker
 
 	pool<string> log_msg_cache;
 
+	// Properties of a template that are the same for every cell it is
+	// instantiated for, computed when the template is first used.
+	struct TechmapTemplateInfo {
+		dict<IdString, IdString> positional_ports;
+		pool<SigBit> written_bits;
+		bool replace_cell = false;
+	};
+
+	dict<RTLIL::Module*, TechmapTemplateInfo> template_infos;
+
 	struct TechmapWireData {
 		RTLIL::Wire *wire;
 		RTLIL::SigSpec value;
@@ -110,6 +117,33 @@ struct TechmapWorker
 		return stringf("$paramod$constmap:%s%s", sha1(constmap_info).c_str(), tpl->name.c_str());
 	}
 
+	const TechmapTemplateInfo &template_info(RTLIL::Module *tpl)
+	{
+		auto it = template_infos.find(tpl);
+		if (it != template_infos.end())
+			return it->second;
+
+		TechmapTemplateInfo &info = template_infos[tpl];
+
+		for (auto tpl_w : tpl->wires())
+			if (tpl_w->port_id > 0)
+				info.positional_ports.emplace(stringf("$%d", tpl_w->port_id), tpl_w->name);
+
+		for (auto tpl_cell : tpl->cells()) {
+			if (tpl_cell->name == ID::_TECHMAP_REPLACE_)
+				info.replace_cell = true;
+			for (auto &conn : tpl_cell->connections())
+				if (tpl_cell->output(conn.first))
+					for (auto bit : conn.second)
+						info.written_bits.insert(bit);
+		}
+		for (auto &conn : tpl->connections())
+			for (auto bit : conn.first)
+				info.written_bits.insert(bit);
+
+		return info;
+	}
+
 	TechmapWires techmap_find_special_wires(RTLIL::Module *module)
 	{
 		TechmapWires result;
@@ -160,15 +194,14 @@ struct TechmapWorker
 				log_error("Technology map yielded processes -> this is not supported (use -autoproc to run 'proc' automatically).\n");
 		}
 
+		const TechmapTemplateInfo &info = template_info(tpl);
+
 		std::string orig_cell_name;
 		pool<string> extra_src_attrs = cell->get_strpool_attribute(ID::src);
 
 		orig_cell_name = cell->name.str();
-		for (auto tpl_cell : tpl->cells())
-			if (tpl_cell->name == ID::_TECHMAP_REPLACE_) {
-				module->rename(cell, stringf("$techmap%d", autoidx++) + cell->name.str());
-				break;
-			}
+		if (info.replace_cell)
+			module->rename(cell, stringf("$techmap%d", autoidx++) + cell->name.str());
 
 		dict<IdString, IdString> memory_renames;
 
@@ -182,8 +215,8 @@ struct TechmapWorker
 			design->select(module, m);
 		}
 
-		dict<IdString, IdString> positional_ports;
 		dict<Wire*, IdString> temp_renamed_wires;
+		dict<Wire*, Wire*> wire_map;
 		pool<SigBit> autopurge_tpl_bits;
 
 		for (auto tpl_w : tpl->wires())
@@ -191,7 +224,6 @@ struct TechmapWorker
 			if (tpl_w->port_id > 0)
 			{
 				IdString posportname = stringf("$%d", tpl_w->port_id);
-				positional_ports.emplace(posportname, tpl_w->name);
 
 				if (tpl_w->get_bool_attribute(ID::techmap_autopurge) &&
 						(!cell->hasPort(tpl_w->name) || !GetSize(cell->getPort(tpl_w->name))) &&
@@ -224,6 +256,7 @@ struct TechmapWorker
 				if (w->attributes.count(ID::src))
 					w->add_strpool_attribute(ID::src, extra_src_attrs);
 			}
+			wire_map[tpl_w] = w;
 			design->select(module, w);
 
 			if (tpl_w->name.begins_with("\\_TECHMAP_REPLACE_.")) {
@@ -233,23 +266,13 @@ struct TechmapWorker
 			}
 		}
 
-		pool<SigBit> tpl_written_bits;
-		for (auto tpl_cell : tpl->cells())
-		for (auto &conn : tpl_cell->connections())
-			if (tpl_cell->output(conn.first))
-				for (auto bit : conn.second)
-					tpl_written_bits.insert(bit);
-		for (auto &conn : tpl->connections())
-			for (auto bit : conn.first)
-				tpl_written_bits.insert(bit);
-
 		SigMap port_signal_map;
 
 		for (auto &it : cell->connections())
 		{
 			IdString portname = it.first;
-			if (positional_ports.count(portname) > 0)
-				portname = positional_ports.at(portname);
+			if (info.positional_ports.count(portname) > 0)
+				portname = info.positional_ports.at(portname);
 			if (tpl->wire(portname) == nullptr || tpl->wire(portname)->port_id == 0) {
 				if (portname.begins_with("$"))
 					log_error("Can't map port `%s' of cell `%s' to template `%s'!\n", portname.c_str(), cell->name.c_str(), tpl->name.c_str());
@@ -265,20 +288,20 @@ struct TechmapWorker
 			if (w->port_output && !w->port_input) {
 				c.first = it.second;
 				c.second = RTLIL::SigSpec(w);
-				apply_prefix(cell->name, c.second, module);
+				apply_wire_map(wire_map, c.second);
 				extra_connect.first = c.second;
 				extra_connect.second = c.first;
 			} else if (!w->port_output && w->port_input) {
 				c.first = RTLIL::SigSpec(w);
 				c.second = it.second;
-				apply_prefix(cell->name, c.first, module);
+				apply_wire_map(wire_map, c.first);
 				extra_connect.first = c.first;
 				extra_connect.second = c.second;
 			} else {
 				SigSpec sig_tpl = w, sig_tpl_pf = w, sig_mod = it.second;
-				apply_prefix(cell->name, sig_tpl_pf, module);
+				apply_wire_map(wire_map, sig_tpl_pf);
 				for (int i = 0; i < GetSize(sig_tpl) && i < GetSize(sig_mod); i++) {
-					if (tpl_written_bits.count(sig_tpl[i])) {
+					if (info.written_bits.count(sig_tpl[i])) {
 						c.first.append(sig_mod[i]);
 						c.second.append(sig_tpl_pf[i]);
 					} else {
@@ -360,7 +383,7 @@ struct TechmapWorker
 					autopurge_ports.push_back(conn.first);
 				} else {
 					RTLIL::SigSpec new_conn = conn.second;
-					apply_prefix(cell->name, new_conn, module);
+					apply_wire_map(wire_map, new_conn);
 					port_signal_map.apply(new_conn);
 					c->setPort(conn.first, std::move(new_conn));
 				}
@@ -392,8 +415,8 @@ struct TechmapWorker
 
 		for (auto &it : tpl->connections()) {
 			RTLIL::SigSig c = it;
-			apply_prefix(cell->name.str(), c.first, module);
-			apply_prefix(cell->name.str(), c.second, module);
+			apply_wire_map(wire_map, c.first);
+			apply_wire_map(wire_map, c.second);
 			port_signal_map.apply(c.first);
 			port_signal_map.apply(c.second);
 			module->connect(c);
@@ -1142,6 +1165,132 @@ struct TechmapPass : public Pass {
 		log("essentially techmap but using the design itself as map library).\n");
 		log("\n");
 	}
+
+	// Map designs are read once per combination of map files and frontend
+	// options and kept for the rest of the session. Every techmap call works
+	// on its own copy, since deriving templates adds modules to the map design.
+	// An entry is reused as long as none of the files read for it (including
+	// the ones pulled in with `include) has changed its content.
+	struct MapCacheEntry {
+		std::vector<std::pair<std::string, std::string>> files;
+		RTLIL::Design *map = nullptr;
+		dict<IdString, pool<IdString>> celltypeMap;
+	};
+	dict<std::string, MapCacheEntry> map_cache;
+	MapCacheEntry uncached_map;
+
+	static void build_celltype_map(RTLIL::Design *map, dict<IdString, pool<IdString>> &celltypeMap)
+	{
+		for (auto module : map->modules()) {
+			if (module->attributes.count(ID::techmap_celltype) && !module->attributes.at(ID::techmap_celltype).bits.empty()) {
+				char *p = strdup(module->attributes.at(ID::techmap_celltype).decode_string().c_str());
+				for (char *q = strtok(p, " \t\r\n"); q; q = strtok(nullptr, " \t\r\n")) {
+					std::vector<std::string> queue;
+					queue.push_back(q);
+					while (!queue.empty()) {
+						std::string name = queue.back();
+						queue.pop_back();
+						auto pos = name.find('[');
+						if (pos == std::string::npos) {
+							// No further expansion.
+							celltypeMap[RTLIL::escape_id(name)].insert(module->name);
+						} else {
+							// Expand [] in this name.
+							auto epos = name.find(']', pos);
+							if (epos == std::string::npos)
+								log_error("Malformed techmap_celltype pattern %s\n", q);
+							for (size_t i = pos + 1; i < epos; i++) {
+								queue.push_back(name.substr(0, pos) + name[i] + name.substr(epos + 1, std::string::npos));
+							}
+						}
+					}
+				}
+				free(p);
+			} else {
+				IdString module_name = module->name.begins_with("\\$") ?
+						module->name.substr(1) : module->name.str();
+				celltypeMap[module_name].insert(module->name);
+			}
+		}
+	}
+
+	const MapCacheEntry &load_map_files(const std::vector<std::string> &map_files, const std::string &verilog_frontend)
+	{
+		std::string key = verilog_frontend;
+		for (auto &arg : verilog_defaults)
+			key += " " + arg;
+		for (auto &fn : map_files)
+			key += "\n" + fn;
+
+		bool cacheable = true;
+		for (auto &fn : map_files)
+			if (fn.compare(0, 1, "%") == 0)
+				cacheable = false;
+
+		if (cacheable && map_cache.count(key)) {
+			MapCacheEntry &entry = map_cache.at(key);
+			bool unchanged = true;
+			for (auto &it : entry.files)
+				if (SHA1::from_file(it.first) != it.second) {
+					unchanged = false;
+					break;
+				}
+			if (unchanged) {
+				for (auto &fn : map_files)
+					log("Using cached map design for %s.\n", fn.c_str());
+				for (auto &it : entry.files)
+					yosys_input_files.insert(it.first);
+				return entry;
+			}
+		}
+
+		// Collect the files opened by the frontends while reading the map files.
+		std::set<std::string> input_files;
+		input_files.swap(yosys_input_files);
+
+		RTLIL::Design *map = new RTLIL::Design;
+		try {
+			for (auto &fn : map_files)
+				if (fn.compare(0, 1, "%") == 0) {
+					if (!saved_designs.count(fn.substr(1))) {
+						delete map;
+						log_cmd_error("Can't open saved design `%s'.\n", fn.c_str()+1);
+					}
+					for (auto mod : saved_designs.at(fn.substr(1))->modules())
+						if (!map->module(mod->name))
+							map->add(mod->clone());
+				} else {
+					Frontend::frontend_call(map, nullptr, fn, (fn.size() > 3 && fn.compare(fn.size()-3, std::string::npos, ".il") == 0 ? "rtlil" : verilog_frontend));
+				}
+		} catch (...) {
+			yosys_input_files.insert(input_files.begin(), input_files.end());
+			throw;
+		}
+
+		input_files.swap(yosys_input_files);
+		yosys_input_files.insert(input_files.begin(), input_files.end());
+
+		MapCacheEntry &entry = cacheable ? map_cache[key] : uncached_map;
+		delete entry.map;
+		entry.map = map;
+		entry.files.clear();
+		if (cacheable)
+			for (auto &fn : input_files)
+				entry.files.push_back(std::make_pair(fn, SHA1::from_file(fn)));
+		entry.celltypeMap.clear();
+		build_celltype_map(map, entry.celltypeMap);
+		return entry;
+	}
+
+	void on_shutdown() override
+	{
+		for (auto &it : map_cache)
+			delete it.second.map;
+		map_cache.clear();
+		delete uncached_map.map;
+		uncached_map.map = nullptr;
+	}
+
 	void execute(std::vector<std::string> args, RTLIL::Design *design) override
 	{
 		log_header(design, "Executing TECHMAP pass (map to technology primitives).\n");
@@ -1196,58 +1345,17 @@ struct TechmapPass : public Pass {
 		}
 		extra_args(args, argidx, design);
 
+		if (map_files.empty())
+			map_files.push_back("+/techmap.v");
+
+		const MapCacheEntry &map_entry = load_map_files(map_files, verilog_frontend);
 		RTLIL::Design *map = new RTLIL::Design;
-		if (map_files.empty()) {
-			Frontend::frontend_call(map, nullptr, "+/techmap.v", verilog_frontend);
-		} else {
-			for (auto &fn : map_files)
-				if (fn.compare(0, 1, "%") == 0) {
-					if (!saved_designs.count(fn.substr(1))) {
-						delete map;
-						log_cmd_error("Can't open saved design `%s'.\n", fn.c_str()+1);
-					}
-					for (auto mod : saved_designs.at(fn.substr(1))->modules())
-						if (!map->module(mod->name))
-							map->add(mod->clone());
-				} else {
-					Frontend::frontend_call(map, nullptr, fn, (fn.size() > 3 && fn.compare(fn.size()-3, std::string::npos, ".il") == 0 ? "rtlil" : verilog_frontend));
-				}
-		}
+		for (auto mod : map_entry.map->modules())
+			map->add(mod->clone());
+		dict<IdString, pool<IdString>> celltypeMap = map_entry.celltypeMap;
 
 		log_header(design, "Continuing TECHMAP pass.\n");
 
-		dict<IdString, pool<IdString>> celltypeMap;
-		for (auto module : map->modules()) {
-			if (module->attributes.count(ID::techmap_celltype) && !module->attributes.at(ID::techmap_celltype).bits.empty()) {
-				char *p = strdup(module->attributes.at(ID::techmap_celltype).decode_string().c_str());
-				for (char *q = strtok(p, " \t\r\n"); q; q = strtok(nullptr, " \t\r\n")) {
-					std::vector<std::string> queue;
-					queue.push_back(q);
-					while (!queue.empty()) {
-						std::string name = queue.back();
-						queue.pop_back();
-						auto pos = name.find('[');
-						if (pos == std::string::npos) {
-							// No further expansion.
-							celltypeMap[RTLIL::escape_id(name)].insert(module->name);
-						} else {
-							// Expand [] in this name.
-							auto epos = name.find(']', pos);
-							if (epos == std::string::npos)
-								log_error("Malformed techmap_celltype pattern %s\n", q);
-							for (size_t i = pos + 1; i < epos; i++) {
-								queue.push_back(name.substr(0, pos) + name[i] + name.substr(epos + 1, std::string::npos));
-							}
-						}
-					}
-				}
-				free(p);
-			} else {
-				IdString module_name = module->name.begins_with("\\$") ?
-						module->name.substr(1) : module->name.str();
-				celltypeMap[module_name].insert(module->name);
-			}
-		}
 		log_debug("Cell type mappings to use:\n");
 		for (auto &i : celltypeMap) {
 			i.second.sort(RTLIL::sort_by_id_str());
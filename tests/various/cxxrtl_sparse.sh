@@ -0,0 +1,71 @@
+#!/bin/bash
+
+trap 'echo "ERROR in cxxrtl_sparse.sh" >&2; exit 1' ERR
+
+# The initializers overlap: `mem` is initialized as a whole, and then some of its words again. The backend emits
+# them ordered by priority and address, and sparse memories must apply them in the same way as dense ones.
+cat > cxxrtl_sparse.il << "EOT"
+module \top
+  wire input 1 \clk
+  memory width 8 size 2100 \mem
+  cell $meminit $init_all
+    parameter \MEMID "\\mem"
+    parameter \ABITS 32
+    parameter \WIDTH 8
+    parameter \WORDS 8
+    parameter \PRIORITY 2
+    connect \ADDR 0
+    connect \DATA 64'1000000110000010100000111000010010000101100001101000011110001000
+  end
+  cell $meminit $init_one
+    parameter \MEMID "\\mem"
+    parameter \ABITS 32
+    parameter \WIDTH 8
+    parameter \WORDS 1
+    parameter \PRIORITY 1
+    connect \ADDR 2
+    connect \DATA 8'01010101
+  end
+  cell $meminit $init_far
+    parameter \MEMID "\\mem"
+    parameter \ABITS 32
+    parameter \WIDTH 8
+    parameter \WORDS 2
+    parameter \PRIORITY 1
+    connect \ADDR 2047
+    connect \DATA 16'0110011001110111
+  end
+end
+EOT
+
+cat > cxxrtl_sparse_tb.cc << "EOT"
+#include <cstdio>
+#include "cxxrtl_sparse_design.cc"
+
+int main()
+{
+	cxxrtl_design::p_top top;
+	// Direct writes through the same operator for dense and sparse memories.
+	top.memory_p_mem[5] = cxxrtl::value<8>{0xa5u};
+	top.memory_p_mem[1500] = cxxrtl::value<8>{0x3cu};
+	const auto &mem = top.memory_p_mem;
+	for (size_t index = 0; index < 2100; index++)
+		printf("%zu %02x\n", index, (unsigned)mem[index].get<uint8_t>());
+	return 0;
+}
+EOT
+
+CXX=${CXX:-c++}
+for mode in dense sparse; do
+	if [ $mode = sparse ]; then opts="-sparse 1024"; else opts=""; fi
+	../../yosys -q -p "read_rtlil cxxrtl_sparse.il; write_cxxrtl $opts cxxrtl_sparse_design.cc"
+	if [ $mode = sparse ]; then grep -q "sparse_memory<8> memory_p_mem" cxxrtl_sparse_design.cc; fi
+	$CXX -std=c++14 -I../.. -o cxxrtl_sparse_$mode cxxrtl_sparse_tb.cc
+	./cxxrtl_sparse_$mode > cxxrtl_sparse_$mode.out
+done
+cmp cxxrtl_sparse_dense.out cxxrtl_sparse_sparse.out
+grep -qx "2 55" cxxrtl_sparse_sparse.out
+grep -qx "3 85" cxxrtl_sparse_sparse.out
+grep -qx "5 a5" cxxrtl_sparse_sparse.out
+grep -qx "1500 3c" cxxrtl_sparse_sparse.out
+grep -qx "2048 66" cxxrtl_sparse_sparse.out
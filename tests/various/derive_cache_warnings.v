@@ -0,0 +1,6 @@
+module sub #(parameter W = 2) (input [W-1:0] a, output y);
+assign y = a[W > 2 ? W : 0];
+endmodule
+module top(input [3:0] a, output y);
+sub #(.W(4)) s(a, y);
+endmodule
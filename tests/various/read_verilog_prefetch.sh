@@ -0,0 +1,21 @@
+#!/bin/bash
+
+trap 'echo "ERROR in read_verilog_prefetch.sh" >&2; exit 1' ERR
+
+# Prefetch the input files of read_verilog on worker threads, even on machines with a single core.
+export YOSYS_FORCE_THREADS=4
+
+echo 'module prefetch_a(output y); assign y = 1'"'"'b0; endmodule' > read_verilog_prefetch_a.v
+echo 'module prefetch_b(output y); assign y = 1'"'"'b0; endmodule' > read_verilog_prefetch_b.v
+rm -f read_verilog_prefetch_missing.v read_verilog_prefetch.il
+
+# The missing file aborts the first read_verilog command in the interactive shell after the last file was
+# prefetched. The changed contents of that file must be read by the next read_verilog command.
+../../yosys -q > /dev/null << "EOT"
+read_verilog read_verilog_prefetch_a.v read_verilog_prefetch_missing.v read_verilog_prefetch_b.v
+!sed -i s/1.b0/1\'b1/ read_verilog_prefetch_b.v
+read_verilog read_verilog_prefetch_b.v
+write_rtlil read_verilog_prefetch.il
+EOT
+
+grep -q "connect \\\\y 1'1" read_verilog_prefetch.il